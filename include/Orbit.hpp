@@ -1,11 +1,39 @@
 #pragma once
 #include <functional>
+#include <string>
+#include <vector>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace orbit
 {
     const char* ThreadName();
 
+    namespace configuration
+    {
+        static const unsigned int MAX_WORKER_THREAD_COUNT = 16;
+        static const unsigned int MAX_TASK_COUNT = 4096;
+        static const unsigned int CACHE_LINE_SIZE = 64;
+        static const size_t SCRATCH_ARENA_SIZE = 256 * 1024;
+        static const size_t FRAME_ARENA_SIZE = 4 * 1024 * 1024;
+        static const size_t TILE_SIZE = 16 * 1024;
+        static const unsigned int MAX_TILE_STREAMS = 3;
+        static const unsigned int MAX_INDEXED_STREAMS = 3;
+        static const int64_t WORKER_GROWTH_DELAY_US = 500;
+        static const unsigned int MAX_TIMER_COUNT = 1024 * 1024;
+    }
+
     struct TaskId
     {
         typedef size_t Offset;
@@ -31,6 +59,106 @@ namespace orbit
         size_t elementStride;
     };
 
+    struct PitchedStream
+    {
+        inline PitchedStream(void* _data, size_t _stride, size_t _rowPitch, size_t _slicePitch = 0)
+            : data(_data), elementStride(_stride), rowPitch(_rowPitch), slicePitch(_slicePitch) {}
+
+        void* data;
+        size_t elementStride;
+        size_t rowPitch;
+        size_t slicePitch;
+    };
+
+
+    /// Bump allocator owned by a single thread. Allocations are released all at once by rewinding or resetting the arena.
+    class LinearArena
+    {
+    public:
+        explicit LinearArena(size_t _capacity);
+        LinearArena(const LinearArena &) = delete;
+        ~LinearArena();
+
+        /// Returns \c nullptr once the arena is exhausted.
+        void* allocate(size_t _size, size_t _alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T* allocate(size_t _count)
+        {
+            return static_cast<T*>(allocate(sizeof(T) * _count, alignof(T)));
+        }
+
+        /// Everything allocated after \a mark() is released again by \a rewind().
+        size_t mark() const { return offset; }
+        void rewind(size_t _mark) { offset = _mark; }
+        void reset() { offset = 0; }
+
+        size_t used() const { return offset; }
+        size_t highWaterMark() const { return highWater; }
+        size_t capacity() const { return size; }
+
+    private:
+        char* memory;
+        size_t size;
+        size_t offset;
+        size_t highWater;
+    };
+
+    /// Bump allocator shared by all threads, allocations stay valid until the arena is reset.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t _capacity);
+        FrameArena(const FrameArena &) = delete;
+        ~FrameArena();
+
+        /// Returns \c nullptr once the arena is exhausted.
+        void* allocate(size_t _size, size_t _alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T* allocate(size_t _count)
+        {
+            return static_cast<T*>(allocate(sizeof(T) * _count, alignof(T)));
+        }
+
+        /// Must not be called while other threads allocate from the arena.
+        void reset() { offset.store(0, std::memory_order_relaxed); }
+
+        size_t used() const { return offset.load(std::memory_order_relaxed); }
+        size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+        size_t capacity() const { return size; }
+
+    private:
+        char* memory;
+        size_t size;
+        std::atomic<size_t> offset;
+        std::atomic<size_t> highWater;
+    };
+
+    /// Cancellation state of a task. Tokens are chained through the parents of a task, so cancelling
+    /// a root also cancels every task beneath it.
+    struct CancellationToken
+    {
+        CancellationToken() : parent(nullptr)
+        {
+            cancelled = false;
+        }
+
+        bool isCancelled() const
+        {
+            for (const CancellationToken* token = this; token != nullptr; token = token->parent)
+            {
+                if (token->cancelled.load(std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::atomic<bool> cancelled;
+        const CancellationToken* parent;
+    };
 
     struct TaskData
     {
@@ -39,63 +167,1454 @@ namespace orbit
             size_t elementCount;
             void* inputStreams[3];
             void* outputStreams[3];
+
+            /// Alignment in bytes which all streams of this chunk start at.
+            size_t alignment;
+        };
+
+        struct IoData
+        {
+            int64_t* result;
+        };
+
+        struct TileData
+        {
+            /// Bounds of the tile in x, y and z, \c end is exclusive.
+            size_t begin[3];
+            size_t end[3];
+
+            /// Address of the first element of the tile in every stream, together with the pitches to walk it.
+            void* streams[3];
+            size_t rowPitch[3];
+            size_t slicePitch[3];
+        };
+
+        struct IndexedData
+        {
+            /// Slice of the index list this chunk works on.
+            size_t indexCount;
+            uint32_t* indices;
+
+            /// Base address and stride of every stream, elements are addressed through the indices.
+            void* inputStreams[3];
+            size_t inputStrides[3];
+            void* outputStreams[3];
+            size_t outputStrides[3];
+
+            /// Address of the element the \a _i-th index of the slice refers to.
+            void* gather(size_t _stream, size_t _i) const
+            {
+                return static_cast<char*>(inputStreams[_stream]) + indices[_i] * inputStrides[_stream];
+            }
+
+            void* scatter(size_t _stream, size_t _i) const
+            {
+                return static_cast<char*>(outputStreams[_stream]) + indices[_i] * outputStrides[_stream];
+            }
         };
 
         union TaskSpecificData
         {
             StreamingData streamingData;
+            IoData ioData;
+            TileData tileData;
+            IndexedData indexedData;
         };
 
+        /// Lets long running kernels poll whether their task tree has been cancelled.
+        bool isCancelled() const
+        {
+            return cancellation->isCancelled();
+        }
+
         void* kernelData;
         TaskSpecificData specificData;
+        const CancellationToken* cancellation;
+
+        /// Scratch memory of the worker running the task, released when the task finishes or at the next frame boundary.
+        LinearArena* scratch;
+
+        /// Memory shared by all tasks which stays valid until Scheduler::resetFrameArena.
+        FrameArena* frame;
+    };
+
+    /// A file mapped into memory, used as source or destination of Scheduler::addMappedStreamingTask.
+    class MappedFile
+    {
+    public:
+        enum Advice
+        {
+            WILL_NEED,
+            DONT_NEED,
+        };
+
+        MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        ~MappedFile();
+
+        /// Maps an existing file read-only, returns \c false if it cannot be opened or mapped.
+        bool openForReading(const char* _path);
+
+        /// Creates or truncates a file of \a _size bytes and maps it writable.
+        bool createForWriting(const char* _path, size_t _size);
+
+        void close();
+
+        /// Hints the operating system about the use of a range, the range is widened to whole pages.
+        void advise(size_t _offset, size_t _length, Advice _advice) const;
+
+        /// Starts writing back modified pages of a range without waiting for it.
+        void flush(size_t _offset, size_t _length) const;
+
+        bool isOpen() const { return opened; }
+        void* data() const { return memory; }
+        size_t size() const { return length; }
+
+    private:
+        bool map(bool _writable);
+
+        void* memory;
+        size_t length;
+        bool opened;
+#ifdef _WIN32
+        void* file;
+        void* mapping;
+#else
+        int file;
+#endif
     };
 
     typedef std::function<void(const TaskData&)> Kernel;
-    class Task;
+
+    class Freelist
+    {
+        typedef Freelist Self;
+
+    public:
+        Freelist(void* _start, void* _end, size_t stride);
+        void* Obtain();
+        void Return(void* _ptr);
+
+    private:
+        Self* next;
+    };
+
+    /// The part of a pooled task which changes while its tree runs. TaskPool keeps these in an array of their own, one per
+    /// cache line, so counting down a task does not invalidate the payload of its neighbours.
+    struct TaskControl
+    {
+        std::atomic<size_t> openTasks;
+        int32_t generation;
+        TaskId::Offset parent;
+    };
+
+    struct PendingTimer;
+
+    /// A pooled task, \a KernelType is Kernel unless a BasicScheduler policy stores kernels differently.
+    template<typename KernelType>
+    struct BasicTask
+    {
+        static const TaskId::Offset NO_PARENT = -1;
+
+        /// Offset of tasks which were run inline by the spawning thread and never entered the pool.
+        static const TaskId::Offset INLINED = -2;
+
+        /// Delayed and periodic tasks are identified by their timer until they fire, their offsets follow the pool's.
+        static const TaskId::Offset FIRST_TIMER = configuration::MAX_TASK_COUNT;
+        static bool isTimer(TaskId::Offset _offset)
+        {
+            return _offset >= FIRST_TIMER && _offset < FIRST_TIMER + configuration::MAX_TIMER_COUNT;
+        }
+
+        BasicTask()
+        {
+            taskData.cancellation = &cancellation;
+            taskData.scratch = nullptr;
+            taskData.frame = nullptr;
+            priority = 0;
+            label = nullptr;
+            durationKey = 0;
+            timer = nullptr;
+        }
+        Freelist* unusedFreelistAlias;
+        KernelType kernel;
+        TaskData taskData;
+        CancellationToken cancellation;
+
+        /// Expected time from the start of this task until its root finishes, used to order the queue.
+        uint64_t priority;
+        const char* label;
+        uint64_t durationKey;
+
+        /// Timer which released this task, it is told once the task has finished.
+        PendingTimer* timer;
+    };
+
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::NO_PARENT;
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::INLINED;
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::FIRST_TIMER;
+
+    typedef BasicTask<Kernel> Task;
+
+    template<typename T>
+    const T& nextElement(const std::queue<T>& _queue)
+    {
+        return _queue.front();
+    }
+
+    template<typename T, typename Container, typename Compare>
+    const T& nextElement(const std::priority_queue<T, Container, Compare>& _queue)
+    {
+        return _queue.top();
+    }
+
+    template<typename T, typename Queue = std::queue<T>>
+    class LockingQueue
+    {
+    public:
+        void push(T const& _data)
+        {
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                queue.push(_data);
+            }
+            signal.notify_one();
+        }
+
+        void push(T const* _data, size_t _count)
+        {
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                for (size_t i = 0; i != _count; ++i)
+                {
+                    queue.push(_data[i]);
+                }
+            }
+
+            if (_count > 1)
+            {
+                signal.notify_all();
+            }
+            else
+            {
+                signal.notify_one();
+            }
+        }
+
+        /// Wakes up one waiting thread without pushing any data.
+        void notifyOne()
+        {
+            signal.notify_one();
+        }
+
+        bool empty() const
+        {
+            std::lock_guard<std::mutex> lock(guard);
+            return queue.empty();
+        }
+
+        bool tryPop(T& _value)
+        {
+            std::lock_guard<std::mutex> lock(guard);
+            if (queue.empty())
+            {
+                return false;
+            }
+
+            _value = nextElement(queue);
+            queue.pop();
+            return true;
+        }
+
+        void waitAndPop(T& _value)
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            while (queue.empty())
+            {
+                signal.wait(lock);
+            }
+
+            _value = nextElement(queue);
+            queue.pop();
+        }
+
+        bool tryWaitAndPop(T& _value, int _milli)
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            while (queue.empty())
+            {
+                signal.wait_for(lock, std::chrono::milliseconds(_milli));
+                return false;
+            }
+
+            _value = nextElement(queue);
+            queue.pop();
+            return true;
+        }
+
+    private:
+        Queue queue;
+        mutable std::mutex guard;
+        std::condition_variable signal;
+    };
+
+    /// Hands out \a Capacity tasks through a freelist. The control state of every task lives apart from its payload,
+    /// see TaskControl.
+    template<typename TaskType, size_t Capacity>
+    class BasicTaskPool
+    {
+    public:
+        BasicTaskPool() : taskPoolMemory(new char[TASK_POOL_SIZE]), controlMemory(new char[sizeof(PaddedControl) * (Capacity + 1)]),
+            futureTaskPool(taskPoolMemory.get(), taskPoolMemory.get() + TASK_POOL_SIZE, sizeof(TaskType))
+        {
+            // heap memory is not guaranteed to be cache line aligned, so align the control array by hand
+            const uintptr_t address = reinterpret_cast<uintptr_t>(controlMemory.get());
+            const uintptr_t aligned = (address + configuration::CACHE_LINE_SIZE - 1) & ~uintptr_t(configuration::CACHE_LINE_SIZE - 1);
+            control = reinterpret_cast<PaddedControl*>(aligned);
+            generation = 0;
+            availableTasks = Capacity;
+            for (size_t i = 0; i != Capacity; ++i)
+            {
+                new(&control[i]) PaddedControl();
+                control[i].control.openTasks = 0;
+                control[i].control.generation = 0;
+                control[i].control.parent = TaskType::NO_PARENT;
+            }
+        }
+
+        BasicTaskPool(const BasicTaskPool&) = delete;
+
+        TaskType* obtainTask()
+        {
+            void* memory = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                memory = futureTaskPool.Obtain();
+            }
+            --availableTasks;
+
+            TaskType* task = new(memory) TaskType();
+
+            TaskControl& taskControl = getControl(task);
+            taskControl.openTasks = 1;
+            taskControl.parent = TaskType::NO_PARENT;
+
+            // the generation is a unique ID which allows us to distinguish between proper tasks and deleted ones
+            taskControl.generation = ++generation;
+            return task;
+        }
+
+        void returnTask(TaskType* _task)
+        {
+            getControl(_task).generation = ++generation;
+
+            // releases whatever the kernel captured, the freelist reuses the memory right away
+            _task->~TaskType();
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                futureTaskPool.Return(_task);
+            }
+            ++availableTasks;
+        }
+
+        TaskId::Offset getTaskOffset(TaskType* _task)
+        {
+            return _task - reinterpret_cast<TaskType*>(taskPoolMemory.get());
+        }
+
+        TaskType* getTask(TaskId::Offset _taskOffset)
+        {
+            return reinterpret_cast<TaskType*>(taskPoolMemory.get()) + _taskOffset;
+        }
+
+        TaskId getTaskId(TaskType* _task)
+        {
+            const TaskId::Offset offset = getTaskOffset(_task);
+            return TaskId(offset, control[offset].control.generation);
+        }
+
+        TaskControl& getControl(TaskId::Offset _taskOffset) { return control[_taskOffset].control; }
+        TaskControl& getControl(TaskType* _task) { return control[getTaskOffset(_task)].control; }
+        const TaskControl& getControl(TaskId::Offset _taskOffset) const { return control[_taskOffset].control; }
+
+        bool isTaskFinished(const TaskId& _taskId) const
+        {
+            if (_taskId.offset == TaskType::INLINED)
+            {
+                // inlined tasks ran to completion before their id was handed out
+                return true;
+            }
+
+            // only the control state is read, waiting threads never touch the payload workers are using
+            const TaskControl& taskControl = getControl(_taskId.offset);
+            if (taskControl.generation != static_cast<int32_t>(_taskId.generation))
+            {
+                // task is from an older generation and has been recycled again, so it's been finished already
+                return true;
+            }
+            return taskControl.openTasks == 0;
+        }
+
+        /// Number of tasks which can still be obtained, may be outdated as soon as it is returned.
+        size_t getAvailableTaskCount() const { return availableTasks.load(std::memory_order_relaxed); }
+
+    private:
+        static const size_t TASK_POOL_SIZE = sizeof(TaskType) * Capacity;
+
+        // control state lives apart from the payload, padded to whole cache lines
+        struct alignas(configuration::CACHE_LINE_SIZE) PaddedControl
+        {
+            TaskControl control;
+        };
+        static_assert(sizeof(PaddedControl) == configuration::CACHE_LINE_SIZE, "the control state of a task has to fit a cache line");
+
+        std::unique_ptr<char[]> taskPoolMemory;
+        std::unique_ptr<char[]> controlMemory;
+        PaddedControl* control;
+        std::mutex guard;
+
+        Freelist futureTaskPool;
+        std::atomic<int32_t> generation;
+        std::atomic<size_t> availableTasks;
+    };
+
+    typedef BasicTaskPool<Task, configuration::MAX_TASK_COUNT> TaskPool;
+
+    /// Queue of tasks ready to run, first in, first out through the policy's queue or ordered by BasicTask::priority.
+    template<typename TaskType, typename Policy>
+    class BasicTaskQueue
+    {
+    public:
+        BasicTaskQueue()
+        {
+            prioritised = false;
+            sequence = 0;
+            depth = 0;
+            urgentDepth = 0;
+        }
+
+        /// Orders the queue by Task::priority instead of first in, first out. Has to be set before any task is queued.
+        void setPrioritised(bool _prioritised)
+        {
+            prioritised.store(_prioritised, std::memory_order_release);
+        }
+
+        /// Tries to queue a task.
+        void queueTask(TaskType* _task)
+        {
+            ++depth;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                const PrioritisedTask entry = { _task->priority, sequence++, _task };
+                prioritisedQueue.push(entry);
+            }
+            else
+            {
+                queue.push(_task);
+            }
+        }
+
+        /// Queues a batch of tasks at once.
+        void queueTasks(TaskType* const* _tasks, size_t _count)
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                for (size_t i = 0; i != _count; ++i)
+                {
+                    queueTask(_tasks[i]);
+                }
+            }
+            else
+            {
+                depth += _count;
+                queue.push(_tasks, _count);
+            }
+        }
+
+        /// Queues tasks ahead of everything queued so far, such as tasks released by timers which are due already. A
+        /// prioritised queue orders them by Task::priority like any other task.
+        void queueUrgentTasks(TaskType* const* _tasks, size_t _count)
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                queueTasks(_tasks, _count);
+                return;
+            }
+
+            depth += _count;
+            urgentDepth += _count;
+            urgentQueue.push(_tasks, _count);
+
+            // workers wait on the regular queue, a wake up without a task sends them back to getAvailableTask
+            for (size_t i = 0; i != _count; ++i)
+            {
+                queue.notifyOne();
+            }
+        }
+
+        /// Waits the calling thread until a task becomes available in the queue, returns \c nullptr after \a _milliseconds.
+        TaskType* waitUntilTaskIsAvailable(int _milliseconds)
+        {
+            TaskType* task = nullptr;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                PrioritisedTask entry;
+                task = prioritisedQueue.tryWaitAndPop(entry, _milliseconds) ? entry.task : nullptr;
+            }
+            else if (!tryPopUrgent(task))
+            {
+                task = queue.tryWaitAndPop(task, _milliseconds) ? task : nullptr;
+            }
+
+            if (task)
+            {
+                --depth;
+            }
+            return task;
+        }
+
+        /// Wakes up a waiting worker so it can reconsider how long to wait for.
+        void wakeWorker()
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                prioritisedQueue.notifyOne();
+            }
+            else
+            {
+                queue.notifyOne();
+            }
+        }
+
+        /// Approximate number of queued tasks.
+        size_t size() const { return depth.load(std::memory_order_relaxed); }
+
+        /// Tries to get a task from the queue, returns \c nullptr if no task is currently available.
+        TaskType* getAvailableTask()
+        {
+            TaskType* task = nullptr;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                PrioritisedTask entry;
+                task = prioritisedQueue.tryPop(entry) ? entry.task : nullptr;
+            }
+            else if (!tryPopUrgent(task))
+            {
+                task = queue.tryPop(task) ? task : nullptr;
+            }
+
+            if (task)
+            {
+                --depth;
+            }
+            return task;
+        }
+
+    private:
+        bool tryPopUrgent(TaskType*& _task)
+        {
+            // the lane is empty nearly all the time, so it is only locked when something has been queued there
+            if (urgentDepth.load(std::memory_order_relaxed) == 0 || !urgentQueue.tryPop(_task))
+            {
+                return false;
+            }
+            --urgentDepth;
+            return true;
+        }
+
+        struct PrioritisedTask
+        {
+            uint64_t priority;
+            uint64_t sequence;
+            TaskType* task;
+
+            bool operator<(const PrioritisedTask& _other) const
+            {
+                // higher priorities first, tasks of equal priority in the order they were queued
+                return priority != _other.priority ? priority < _other.priority : sequence > _other.sequence;
+            }
+        };
+
+        std::atomic<bool> prioritised;
+        std::atomic<uint64_t> sequence;
+        std::atomic<size_t> depth;
+        std::atomic<size_t> urgentDepth;
+        typename Policy::template Queue<TaskType*> queue;
+        typename Policy::template Queue<TaskType*> urgentQueue;
+        LockingQueue<PrioritisedTask, std::priority_queue<PrioritisedTask>> prioritisedQueue;
+    };
+
+    /// A callable stored inside the task itself instead of on the heap, \a Size bytes are available for its captures.
+    template<size_t Size>
+    class InplaceKernel
+    {
+    public:
+        InplaceKernel() : invoke(nullptr), manage(nullptr) {}
+
+        template<typename Function, typename = typename std::enable_if<!std::is_same<Function, InplaceKernel>::value>::type>
+        InplaceKernel(Function _function) : invoke(&invokeFunction<Function>), manage(&manageFunction<Function>)
+        {
+            static_assert(sizeof(Function) <= Size, "the kernel captures more than the policy's kernel storage holds");
+            static_assert(alignof(Function) <= alignof(std::max_align_t), "the kernel is over-aligned");
+            new(&storage) Function(std::move(_function));
+        }
+
+        InplaceKernel(const InplaceKernel& _other) : invoke(_other.invoke), manage(_other.manage)
+        {
+            if (manage)
+            {
+                manage(&storage, &_other.storage);
+            }
+        }
+
+        InplaceKernel& operator=(const InplaceKernel& _other)
+        {
+            if (this != &_other)
+            {
+                reset();
+                invoke = _other.invoke;
+                manage = _other.manage;
+                if (manage)
+                {
+                    manage(&storage, &_other.storage);
+                }
+            }
+            return *this;
+        }
+
+        ~InplaceKernel()
+        {
+            reset();
+        }
+
+        explicit operator bool() const { return invoke != nullptr; }
+
+        void operator()(const TaskData& _data) const
+        {
+            invoke(&storage, _data);
+        }
+
+    private:
+        typedef typename std::aligned_storage<Size, alignof(std::max_align_t)>::type Storage;
+
+        /// Copies \a _source into \a _destination, or destroys \a _destination if \a _source is \c nullptr.
+        typedef void (*Manage)(Storage* _destination, const Storage* _source);
+        typedef void (*Invoke)(const Storage* _storage, const TaskData& _data);
+
+        template<typename Function>
+        static void invokeFunction(const Storage* _storage, const TaskData& _data)
+        {
+            (*reinterpret_cast<const Function*>(_storage))(_data);
+        }
+
+        template<typename Function>
+        static void manageFunction(Storage* _destination, const Storage* _source)
+        {
+            if (_source)
+            {
+                new(_destination) Function(*reinterpret_cast<const Function*>(_source));
+            }
+            else
+            {
+                reinterpret_cast<Function*>(_destination)->~Function();
+            }
+        }
+
+        void reset()
+        {
+            if (manage)
+            {
+                manage(&storage, nullptr);
+            }
+            invoke = nullptr;
+            manage = nullptr;
+        }
+
+        Storage storage;
+        Invoke invoke;
+        Manage manage;
+    };
+
+    /// Idle strategies decide what a thread without work does. \c relax is called between polls of a waiting or helping
+    /// thread, workers block on the queue for up to \c PARK_MILLISECONDS or relax instead if it is zero.
+    struct SpinIdle
+    {
+        static const int PARK_MILLISECONDS = 0;
+        static void relax() {}
+    };
+
+    struct YieldIdle
+    {
+        static const int PARK_MILLISECONDS = 0;
+        static void relax() { std::this_thread::yield(); }
+    };
+
+    struct BlockingIdle
+    {
+        static const int PARK_MILLISECONDS = 1000;
+        static void relax() { std::this_thread::yield(); }
+    };
+
+    /// Instrumentation which compiles away.
+    struct NoInstrumentation
+    {
+        void taskQueued() {}
+        void taskExecuted() {}
+        void taskHelped() {}
+    };
+
+    /// Counts queued and executed tasks, and how many of them ran on a thread helping while it waited.
+    struct CountingInstrumentation
+    {
+        CountingInstrumentation()
+        {
+            queued = 0;
+            executed = 0;
+            helped = 0;
+        }
+
+        void taskQueued() { queued.fetch_add(1, std::memory_order_relaxed); }
+        void taskExecuted() { executed.fetch_add(1, std::memory_order_relaxed); }
+        void taskHelped() { helped.fetch_add(1, std::memory_order_relaxed); }
+
+        std::atomic<size_t> queued;
+        std::atomic<size_t> executed;
+        std::atomic<size_t> helped;
+    };
+
+    /// The policy Scheduler is built on, other policies can derive from it and override single choices. The queue has to
+    /// provide push, a batch push, tryPop, tryWaitAndPop and notifyOne like LockingQueue.
+    struct DefaultSchedulerPolicy
+    {
+        static const unsigned int MAX_WORKER_THREAD_COUNT = configuration::MAX_WORKER_THREAD_COUNT;
+        static const unsigned int MAX_TASK_COUNT = configuration::MAX_TASK_COUNT;
+
+        typedef orbit::Kernel Kernel;
+
+        template<typename T>
+        using Queue = LockingQueue<T>;
+
+        typedef NoInstrumentation Instrumentation;
+        typedef BlockingIdle Idle;
+    };
+
+    /// Header-only fork/join scheduler configured at compile time. The policy chooses the pool capacity, the queue, how
+    /// kernels are stored, instrumentation and what idle threads do, so adding, running and finishing tasks can inline into
+    /// the caller. Kernels of a standalone BasicScheduler get no scratch or frame arena.
+    ///
+    /// Scheduler holds a BasicScheduler<DefaultSchedulerPolicy> and shares its task pool, queue and streaming split and the
+    /// way tasks are executed and finished. It passes itself as the front end to those calls, which has to provide
+    /// runKernel(Task*), taskFinished(Task*), queueTask(Task*) and helpWithWork(), and adds timers, I/O, arenas and its
+    /// elastic worker pool on top.
+    template<typename Policy>
+    class BasicScheduler
+    {
+    public:
+        typedef typename Policy::Kernel Kernel;
+        typedef typename Policy::Instrumentation Instrumentation;
+        typedef typename Policy::Idle Idle;
+        typedef BasicTask<Kernel> Task;
+        typedef BasicTaskPool<Task, Policy::MAX_TASK_COUNT> TaskPool;
+        typedef BasicTaskQueue<Task, Policy> TaskQueue;
+
+        BasicScheduler() : frontend(*this)
+        {
+            shouldRun = true;
+        }
+
+        BasicScheduler(const BasicScheduler &) = delete;
+
+        ~BasicScheduler()
+        {
+            shouldRun = false;
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        /// Starts the workers of a standalone scheduler, Scheduler runs its own worker pool on the queue instead.
+        void initialise(unsigned int _cores)
+        {
+            const unsigned int count = _cores < Policy::MAX_WORKER_THREAD_COUNT ? _cores : Policy::MAX_WORKER_THREAD_COUNT;
+            for (unsigned int i(0); i != count; ++i)
+            {
+                threads.push_back(std::thread(&BasicScheduler::work, this));
+            }
+        }
+
+        TaskId addTask(void* _kernelData, Kernel _kernel)
+        {
+            Task* task = taskPool.obtainTask();
+            task->kernel = std::move(_kernel);
+            task->taskData.kernelData = _kernelData;
+            return taskPool.getTaskId(task);
+        }
+
+        TaskId addAndRunTask(void* _kernelData, Kernel _kernel)
+        {
+            Task* task = taskPool.obtainTask();
+            task->kernel = std::move(_kernel);
+            task->taskData.kernelData = _kernelData;
+
+            // the task may be finished and recycled as soon as it is queued, so take its id first
+            const TaskId id = taskPool.getTaskId(task);
+            queueTask(task);
+            return id;
+        }
+
+        TaskId addEmptyTask()
+        {
+            return addTask(nullptr, Kernel());
+        }
+
+        /// Splits \a _elementCount elements into chunks of about \a _elementsPerTask and runs \a _kernel on each of them,
+        /// the returned root has to be run like with Scheduler::addStreamingTask. A \a _boundaryAlignment in bytes rounds
+        /// chunk boundaries so every stream of a chunk starts aligned, leftover elements go to a head and a tail chunk.
+        /// \a _cancellation, if given, becomes the parent token of the root before any chunk is queued.
+        TaskId addStreamingTask(Kernel _kernel, void* _kernelData,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0)
+        {
+            return addStreamingTask(frontend, _kernel, _kernelData, _inputs, _outputs, _streamCount, _elementCount, _elementsPerTask, _boundaryAlignment);
+        }
+
+        template<typename Frontend>
+        TaskId addStreamingTask(Frontend& _frontend, const Kernel& _kernel, void* _kernelData,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment,
+            const CancellationToken* _cancellation = nullptr)
+        {
+            // chunk boundaries are placed on multiples of the granularity, so every stream of a chunk starts aligned
+            size_t granularity = 1;
+            size_t headCount = 0;
+            if (_boundaryAlignment > 1)
+            {
+                for (size_t s = 0; s != _streamCount; ++s)
+                {
+                    granularity = leastCommonMultiple(granularity, alignedElementStep(_inputs[s].elementStride, _boundaryAlignment));
+                    granularity = leastCommonMultiple(granularity, alignedElementStep(_outputs[s].elementStride, _boundaryAlignment));
+                }
+
+                // the head chunk takes the elements up to the first boundary at which all streams are aligned
+                for (size_t head = 0; head < granularity && head < _elementCount; ++head)
+                {
+                    bool aligned = true;
+                    for (size_t s = 0; s != _streamCount && aligned; ++s)
+                    {
+                        aligned = isAligned(static_cast<char*>(_inputs[s].data) + head*_inputs[s].elementStride, _boundaryAlignment) &&
+                            isAligned(static_cast<char*>(_outputs[s].data) + head*_outputs[s].elementStride, _boundaryAlignment);
+                    }
+
+                    if (aligned)
+                    {
+                        headCount = head;
+                        break;
+                    }
+                }
+            }
+
+            // split the task into several subtasks, according to the size of the input/output streams
+            const size_t bodyCount = _elementCount - headCount;
+            const size_t N = determineNumberOfTasks(bodyCount, _elementsPerTask);
+            // never less than one granule, a coarse alignment must not fold the whole body into the tail
+            const size_t perElementCount = std::max((bodyCount / N) / granularity * granularity, granularity);
+            const size_t chunkCount = perElementCount != 0 ? bodyCount / perElementCount : 0;
+            const size_t tailCount = bodyCount - chunkCount * perElementCount;
+
+            // add a root task used for synchronisation
+            Task* root = taskPool.obtainTask();
+            root->cancellation.parent = _cancellation;
+            TaskId::Offset rootOffset = taskPool.getTaskOffset(root);
+            TaskControl& rootControl = taskPool.getControl(rootOffset);
+            rootControl.openTasks = chunkCount + (headCount != 0 ? 1 : 0) + (tailCount != 0 ? 1 : 0) + 1;
+
+            // the root cannot finish before it is run, so its id stays valid while the chunks are queued
+            const TaskId rootId = taskPool.getTaskId(root);
+            const size_t alignmentLimit = _boundaryAlignment > configuration::CACHE_LINE_SIZE ? _boundaryAlignment : configuration::CACHE_LINE_SIZE;
+
+            size_t first = 0;
+            const size_t chunkEnd = headCount + chunkCount * perElementCount;
+            while (first != _elementCount)
+            {
+                const size_t count = (first < headCount) ? headCount : (first < chunkEnd ? perElementCount : tailCount);
+
+                Task* task = taskPool.obtainTask();
+                task->kernel = _kernel;
+                taskPool.getControl(task).parent = rootOffset;
+                task->cancellation.parent = &root->cancellation;
+                task->taskData.kernelData = _kernelData;
+
+                TaskData::StreamingData& streamingData = task->taskData.specificData.streamingData;
+                streamingData.elementCount = count;
+                streamingData.alignment = alignmentLimit;
+                for (size_t s = 0; s != 3; ++s)
+                {
+                    void* input = nullptr;
+                    void* output = nullptr;
+                    if (s < _streamCount)
+                    {
+                        input = static_cast<char*>(_inputs[s].data) + first*_inputs[s].elementStride;
+                        output = static_cast<char*>(_outputs[s].data) + first*_outputs[s].elementStride;
+
+                        streamingData.alignment = alignmentOf(input, streamingData.alignment);
+                        streamingData.alignment = alignmentOf(output, streamingData.alignment);
+                    }
+
+                    streamingData.inputStreams[s] = input;
+                    streamingData.outputStreams[s] = output;
+                }
+
+                _frontend.queueTask(task);
+                first += count;
+            }
+
+            return rootId;
+        }
+
+        void addChild(const TaskId& _parent, const TaskId& _child)
+        {
+            taskPool.getControl(_parent.offset).openTasks++;
+            taskPool.getControl(_child.offset).parent = _parent.offset;
+            taskPool.getTask(_child.offset)->cancellation.parent = &taskPool.getTask(_parent.offset)->cancellation;
+        }
+
+        void runTask(const TaskId& _id)
+        {
+            queueTask(taskPool.getTask(_id.offset));
+        }
+
+        /// Cancels a task and every task beneath it. Queued tasks of a cancelled tree are finished without running their kernel.
+        void cancel(const TaskId& _id)
+        {
+            if (taskPool.getControl(_id.offset).generation == static_cast<int32_t>(_id.generation))
+            {
+                // children poll the token chain, so flagging the task is enough to cancel the whole tree
+                taskPool.getTask(_id.offset)->cancellation.cancelled.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        bool isTaskFinished(const TaskId& _id) const
+        {
+            return taskPool.isTaskFinished(_id);
+        }
+
+        /// Waits for the task to finish, the calling thread works on other tasks in the meantime.
+        void wait(const TaskId& _id)
+        {
+            while (!isTaskFinished(_id))
+            {
+                helpWithWork();
+            }
+        }
+
+        const Instrumentation& getInstrumentation() const { return instrumentation; }
+
+        TaskPool& getTaskPool() { return taskPool; }
+        TaskQueue& getQueue() { return queue; }
+
+        void queueTask(Task* _task)
+        {
+            instrumentation.taskQueued();
+            queue.queueTask(_task);
+        }
+
+        /// Runs the task once all its children have finished and finishes it, \a _frontend helps with other work meanwhile.
+        template<typename Frontend>
+        void workOnTask(Frontend& _frontend, Task* _task)
+        {
+            while (!canExecuteTask(_task))
+            {
+                // the task cannot be executed at this time, work on another item
+                _frontend.helpWithWork();
+            }
+
+            _frontend.runKernel(_task);
+            finishTask(_frontend, _task);
+        }
+
+        /// Counts the task down and, once it and all its children are done, returns it to the pool and finishes its parent.
+        template<typename Frontend>
+        void finishTask(Frontend& _frontend, Task* _task)
+        {
+            TaskControl& control = taskPool.getControl(_task);
+            if (--control.openTasks == 0)
+            {
+                _frontend.taskFinished(_task);
+
+                // this task has finished completely, remove it before telling the parent so the slot is free again
+                const TaskId::Offset parent = control.parent;
+                taskPool.returnTask(_task);
+                if (parent != Task::NO_PARENT)
+                {
+                    finishTask(_frontend, taskPool.getTask(parent));
+                }
+            }
+        }
+
+        bool canExecuteTask(Task* _task)
+        {
+            const TaskControl& control = taskPool.getControl(_task);
+            return control.parent == Task::NO_PARENT || control.openTasks == 1;
+        }
+
+        static size_t determineNumberOfTasks(size_t _elementCount, size_t _elementsPerTask)
+        {
+            const size_t numberOfTasks = _elementCount / _elementsPerTask;
+            return numberOfTasks != 0 ? numberOfTasks : 1;
+        }
+
+    private:
+        /// Front end of a standalone scheduler, kernels run right away on the calling thread.
+        struct DirectFrontend
+        {
+            explicit DirectFrontend(BasicScheduler& _scheduler) : scheduler(_scheduler) {}
+
+            void runKernel(Task* _task)
+            {
+                // execute the kernel unless the task tree has been cancelled, the task is finished either way
+                if (_task->kernel && !_task->cancellation.isCancelled())
+                {
+                    _task->kernel(_task->taskData);
+                    scheduler.instrumentation.taskExecuted();
+                }
+            }
+
+            void taskFinished(Task*) {}
+            void queueTask(Task* _task) { scheduler.queueTask(_task); }
+            void helpWithWork() { scheduler.helpWithWork(); }
+
+            BasicScheduler& scheduler;
+        };
+
+        static size_t greatestCommonDivisor(size_t _a, size_t _b)
+        {
+            while (_b != 0)
+            {
+                const size_t remainder = _a % _b;
+                _a = _b;
+                _b = remainder;
+            }
+            return _a;
+        }
+
+        static size_t leastCommonMultiple(size_t _a, size_t _b)
+        {
+            return _a / greatestCommonDivisor(_a, _b) * _b;
+        }
+
+        /// Returns the number of elements after which a stream has advanced by a multiple of \a _alignment bytes.
+        static size_t alignedElementStep(size_t _stride, size_t _alignment)
+        {
+            return _stride != 0 ? _alignment / greatestCommonDivisor(_alignment, _stride) : 1;
+        }
+
+        static bool isAligned(const void* _data, size_t _alignment)
+        {
+            return reinterpret_cast<uintptr_t>(_data) % _alignment == 0;
+        }
+
+        /// Returns the largest power of two up to \a _limit which \a _data is aligned to.
+        static size_t alignmentOf(const void* _data, size_t _limit)
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(_data);
+            const size_t lowestBit = static_cast<size_t>(address & (~address + 1));
+            return (lowestBit == 0 || lowestBit > _limit) ? _limit : lowestBit;
+        }
+
+        void work()
+        {
+            while (shouldRun.load())
+            {
+                Task* task = queue.getAvailableTask();
+                if (!task && Idle::PARK_MILLISECONDS != 0)
+                {
+                    task = queue.waitUntilTaskIsAvailable(Idle::PARK_MILLISECONDS);
+                }
+
+                if (task)
+                {
+                    workOnTask(frontend, task);
+                }
+                else if (Idle::PARK_MILLISECONDS == 0)
+                {
+                    Idle::relax();
+                }
+            }
+        }
+
+        void helpWithWork()
+        {
+            Task* task = queue.getAvailableTask();
+            if (task)
+            {
+                instrumentation.taskHelped();
+                workOnTask(frontend, task);
+            }
+            else
+            {
+                Idle::relax();
+            }
+        }
+
+        TaskPool taskPool;
+        TaskQueue queue;
+        Instrumentation instrumentation;
+        DirectFrontend frontend;
+
+        std::atomic<bool> shouldRun;
+        std::vector<std::thread> threads;
+    };
+
+    class PerfCounters;
+    /// Hardware counters summed over every run of a kernel, see Scheduler::enablePerfCounters.
+    struct KernelCounters
+    {
+        /// Label of the kernel's tasks, \c nullptr if they were not labelled.
+        const char* label;
+        uint64_t key;
+        uint64_t runs;
+
+        uint64_t cycles;
+        uint64_t instructions;
+        uint64_t llcMisses;
+        uint64_t branchMisses;
+    };
+
+    /// A sequence of kernels which Scheduler::addFusedStreamingTask runs over the same streams in a single pass. Every
+    /// chunk runs all kernels up to the next barrier back to back while its data is still in cache.
+    class KernelChain
+    {
+    public:
+        struct Stage
+        {
+            Kernel kernel;
+            void* kernelData;
+        };
+        typedef std::vector<Stage> Segment;
+
+        KernelChain() : segments(1) {}
+
+        /// Appends a kernel, it runs on a chunk after the kernels added before it.
+        KernelChain& add(Kernel _kernel, void* _kernelData)
+        {
+            Stage stage;
+            stage.kernel = _kernel;
+            stage.kernelData = _kernelData;
+            segments.back().push_back(stage);
+            return *this;
+        }
+
+        /// Kernels added after a barrier only start once every chunk has run the kernels before it, e.g. because they
+        /// need a result gathered over the whole stream.
+        KernelChain& barrier()
+        {
+            if (!segments.back().empty())
+            {
+                segments.push_back(Segment());
+            }
+            return *this;
+        }
+
+        const std::vector<Segment>& getSegments() const { return segments; }
+
+    private:
+        std::vector<Segment> segments;
+    };
+
     class Scheduler
     {
     public:
         class Pimpl;
 
+        enum ScratchReset
+        {
+            /// Scratch allocations of a kernel are released as soon as its task has finished.
+            PER_TASK,
+            /// Scratch allocations stay valid until resetScratchArenas is called.
+            PER_FRAME,
+        };
+
+        enum SchedulingPolicy
+        {
+            /// Tasks run in the order they were queued.
+            FIFO,
+            /// Ready tasks with the longest expected path to their root run first, based on measured kernel durations.
+            CRITICAL_PATH,
+        };
+
         Scheduler();
         ~Scheduler();
         void initialise(uint8_t _cores);
 
+        /// Starts \a _minimumCores workers and adds more, up to \a _maximumCores, while the queue stays backed up. Workers
+        /// beyond the minimum retire after \a _idleTimeout without work. Both counts are capped by a cgroup CPU quota.
+        void initialise(uint8_t _minimumCores, uint8_t _maximumCores, std::chrono::milliseconds _idleTimeout);
+
+        /// Number of currently running workers.
+        int getWorkerCount() const;
+
         TaskId addTask(void *_kernelData, Kernel _kernel);
         TaskId addAndRunTask(void *_kernelData, Kernel _kernel);
         TaskId addEmptyTask();
 
+        /// Adds a task which is queued once \a _delay has elapsed, ahead of the tasks queued in the meantime.
+        TaskId addDelayedTask(std::chrono::milliseconds _delay, void *_kernelData, Kernel _kernel);
+
+        /// Adds a task which runs every \a _interval until it is cancelled. The returned task only finishes after cancellation.
+        TaskId addPeriodicTask(std::chrono::milliseconds _interval, void *_kernelData, Kernel _kernel);
+
+        /// Splits the streams into chunks of about \a _elementsPerTask elements. A \a _boundaryAlignment in bytes, such as
+        /// configuration::CACHE_LINE_SIZE or the vector width, rounds chunk boundaries so every stream of a chunk starts
+        /// aligned, leftover elements go to a head and a tail chunk.
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0,
-            size_t elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
 
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0,
             InputStream _is1, OutputStream _os1,
-            size_t _elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
 
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0,
             InputStream _is1, OutputStream _os1,
             InputStream _is2, OutputStream _os2,
-            size_t _elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
+
+        /// Runs \a _kernel over the elements named by \a _indices instead of a contiguous range, so sparse data needs no
+        /// compaction. Every chunk gets its slice of the index list together with the base address and stride of every
+        /// stream and gathers and scatters through them. With \a _sortChunks each chunk first sorts its slice of \a _indices
+        /// in place, which walks the streams in address order. Up to three streams are supported, chunks are grown if there
+        /// would be more than a quarter of the task pool.
+        TaskId addIndexedStreamingTask(Kernel _kernel, void *_kernelData,
+            uint32_t* _indices, size_t _indexCount,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _indicesPerTask, bool _sortChunks = false);
 
+        /// Splits a grid of elements into tiles and runs \a _kernel on every tile. A tile size of zero picks tiles of about
+        /// configuration::TILE_SIZE bytes across all streams, tiles are grown if there would be more than a quarter of the
+        /// task pool. With \a _mortonOrder tiles are queued along a Z-order curve instead of row by row. Up to three streams
+        /// are supported.
+        TaskId addParallelFor2D(Kernel _kernel, void *_kernelData,
+            size_t _width, size_t _height,
+            const PitchedStream* _streams, size_t _streamCount,
+            size_t _tileWidth = 0, size_t _tileHeight = 0, bool _mortonOrder = false);
+
+        TaskId addParallelFor3D(Kernel _kernel, void *_kernelData,
+            size_t _width, size_t _height, size_t _depth,
+            const PitchedStream* _streams, size_t _streamCount,
+            size_t _tileWidth = 0, size_t _tileHeight = 0, size_t _tileDepth = 0, bool _mortonOrder = false);
+
+        /// Runs every segment of \a _chain as one streaming pass over the given streams, all kernels of a segment run on a
+        /// chunk one after another and see the same stream addresses. Segments are separated by the barriers of the chain.
+        /// The chain is copied, the streams have to stay valid until the returned task has finished. The returned driver has to
+        /// be run like the root of addStreamingTask.
+        TaskId addFusedStreamingTask(const KernelChain& _chain,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
+
+        /// Streams the records of a mapped file through \a _kernel, one window of \a _elementsPerWindow records at a time.
+        /// The next window is prefetched while the current one runs and finished windows are released again. Zero, or a
+        /// window with more chunks than a quarter of the task pool, is capped to that quarter. The returned driver has to be
+        /// run like the root of addStreamingTask. \a _output is optional, otherwise it has to hold a record of
+        /// \a _outputStride bytes for every input record. If it is smaller than that nothing is streamed, \a _accepted
+        /// receives \c false and the returned task has already finished. Both files have to stay open until the returned
+        /// task has finished.
+        TaskId addMappedStreamingTask(Kernel _kernel, void *_kernelData,
+            const MappedFile& _input, size_t _inputStride,
+            MappedFile* _output, size_t _outputStride,
+            size_t _elementsPerTask, size_t _elementsPerWindow, bool* _accepted = nullptr);
+
+        /// Reads or writes \a _size bytes at \a _offset of \a _fd. The request is submitted once the returned task is run, so it
+        /// can be given a parent and children like any other task, and the task finishes once the I/O has completed.
+        /// \a _result receives the number of bytes transferred or a negative error code, a cancelled request is never
+        /// submitted. Requests go through io_uring where available and are otherwise done as blocking I/O by the task.
+        TaskId addReadTask(int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result = nullptr);
+        TaskId addWriteTask(int _fd, const void* _buffer, size_t _size, uint64_t _offset, int64_t* _result = nullptr);
+
+        /// Makes \a _parent wait for \a _child. Tasks which were run inline and timers which have fired and finished have
+        /// finished already, such a child is not waited for and the children of such a parent run on their own.
         void addChild(const TaskId& _parent, const TaskId& _child);
         void runTask(const TaskId& _id);
 
+        /// Cancels a task and every task beneath it. Queued tasks of a cancelled tree are finished without running their kernel.
+        void cancel(const TaskId& _taskId);
+        bool isCancelled(const TaskId& _taskId);
+
+        /// Has to be called before any task is queued.
+        void setSchedulingPolicy(SchedulingPolicy _policy);
+
+        /// Kernel durations are recorded per label, tasks without one are keyed by the identity of their kernel.
+        void setLabel(const TaskId& _taskId, const char* _label);
+
+        /// Lets addAndRunTask run the kernel right away on the calling thread once \a _queueDepth tasks are queued or every
+        /// worker is busy. The returned id is already finished. Zero, the default, turns inlining off.
+        void setInlineCutoff(size_t _queueDepth);
+        size_t getInlinedTaskCount() const;
+
+        void setScratchReset(ScratchReset _mode);
+
+        /// Releases all scratch allocations of every worker and every other thread which ran tasks, no tasks may be running.
+        void resetScratchArenas();
+
+        /// Releases all frame arena allocations, no tasks may be running.
+        void resetFrameArena();
+
+        size_t getScratchHighWaterMark() const;
+        size_t getFrameArenaHighWaterMark() const;
+
+        /// Reads cycles, instructions, LLC misses and branch misses around every kernel run and sums them up per kernel,
+        /// kernels are told apart as for CRITICAL_PATH. Counts of a kernel include the tasks it helps with while it waits.
+        /// Returns \c false and stays disabled if perf events are not available or not permitted.
+        bool enablePerfCounters(bool _enable);
+        std::vector<KernelCounters> getKernelCounters() const;
+        void resetKernelCounters();
+
+        /// One line per kernel, the most expensive kernels first.
+        std::string getKernelCounterReport() const;
+
+        /// Gives the calling thread a worker identity of its own, so it works on tasks with a worker's scratch arena.
+        /// Returns \c false if the thread already is a worker or all worker identities are taken.
+        bool attachCurrentThread();
+
+        /// Hands the identity obtained by attachCurrentThread back, pool threads and threads which never attached are left alone.
+        void detach();
+
+        /// Works on queued tasks until \a _predicate returns \c true, attaching the calling thread for the duration if needed.
+        void runUntil(const std::function<bool()>& _predicate);
+
         void wait(const TaskId& _taskId);
         void waitWithoutHelping(const TaskId& _taskId);
 
         void workOnTask(Task* _task);
 
+        /// Releases due timers into the queue and completes finished I/O, returns how many milliseconds the caller may
+        /// wait for work.
+        int serviceIdle();
+
+        /// Services timers and I/O completions if that has not happened during the current tick, called between tasks.
+        void serviceIfDue();
+
     private:
         void helpWithWork();
-        void finishTask(Task* task);
-        bool canExecuteTask(Task* _task);
+        void queueTask(Task* _task);
+        void runKernel(Task* _task);
+        LinearArena* scratchOfCurrentThread();
+        PerfCounters* countersOfCurrentThread();
+        void recordCounters(Task* _task, const uint64_t* _before, const uint64_t* _after);
+        bool shouldRunInline() const;
+        uint64_t durationKey(Task* _task);
+        uint64_t remainingPath(Task* _task);
+        int serviceTimers();
+        TaskId addTimer(uint64_t _delay, uint64_t _interval, void *_kernelData, Kernel _kernel);
+        void finishTimer(PendingTimer* _timer);
+        PendingTimer* getTimer(const TaskId& _taskId);
+        bool isFinished(const TaskId& _taskId);
+        void serviceIo();
+        TaskId addIoTask(int _operation, int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result);
+        TaskId splitTiles(Kernel _kernel, void *_kernelData, const size_t* _extents,
+            const PitchedStream* _streams, size_t _streamCount, const size_t* _tileShape, bool _mortonOrder);
+        void finishTask(Task* _task);
+        void taskFinished(Task* _task);
+
+        // the core calls back into runKernel, taskFinished, queueTask and helpWithWork
+        template<typename Policy> friend class BasicScheduler;
+
+    private:
+        Pimpl *impl;
+    };
+
+    /// Runs a stream of tokens through a sequence of stages on top of a Scheduler. A token moves on to the next stage on
+    /// the worker which finished the previous one, so its data is still in cache.
+    class Pipeline
+    {
+    public:
+        class Pimpl;
+
+        enum StageMode
+        {
+            PARALLEL,
+            SERIAL_IN_ORDER,
+        };
+
+        /// A stage receives the token of the previous stage and returns the token for the next one.
+        typedef std::function<void*(void*)> Stage;
+
+        Pipeline(Scheduler& _scheduler);
+        Pipeline(const Pipeline &) = delete;
+        ~Pipeline();
+
+        /// The first stage is the input, it is called serially with \c nullptr and returns \c nullptr once it is exhausted.
+        void addStage(StageMode _mode, Stage _stage);
 
-        int determineNumberOfTasks(uint32_t _elementCount, uint32_t _elementsPerTask);
+        /// Runs the pipeline until the input is exhausted with at most \a _maxTokens tokens in flight. The calling thread
+        /// helps with work in the meantime.
+        void run(size_t _maxTokens);
 
     private:
         Pimpl *impl;
     };
+
+    /// Ready-made streaming kernels for addStreamingTask. Streams have to be tightly packed arrays of the element type,
+    /// binary operations read inputStreams[0] and inputStreams[1] and write outputStreams[0].
+    namespace kernels
+    {
+        enum InstructionSet
+        {
+            SCALAR,
+            SSE2,
+            AVX2,
+            AVX512,
+        };
+
+        /// Selects the best implementation the CPU supports, called by Scheduler::initialise.
+        void initialise();
+
+        /// Forces a specific implementation, falls back to the best supported one below it.
+        void selectInstructionSet(InstructionSet _instructionSet);
+
+        InstructionSet detectInstructionSet();
+        InstructionSet activeInstructionSet();
+
+        struct SaxpyParameters
+        {
+            float a;
+        };
+
+        struct ClampF32Parameters
+        {
+            float minimum;
+            float maximum;
+        };
+
+        struct ClampI32Parameters
+        {
+            int32_t minimum;
+            int32_t maximum;
+        };
+
+        void addF32(const TaskData& _data);
+        void subtractF32(const TaskData& _data);
+        void multiplyF32(const TaskData& _data);
+        void minF32(const TaskData& _data);
+        void maxF32(const TaskData& _data);
+
+        void addI32(const TaskData& _data);
+        void subtractI32(const TaskData& _data);
+        void multiplyI32(const TaskData& _data);
+        void minI32(const TaskData& _data);
+        void maxI32(const TaskData& _data);
+
+        /// outputStreams[0] = a * inputStreams[0] + inputStreams[1], kernelData points to SaxpyParameters.
+        void saxpy(const TaskData& _data);
+
+        /// Clamps inputStreams[0] into outputStreams[0], kernelData points to ClampF32Parameters/ClampI32Parameters.
+        void clampF32(const TaskData& _data);
+        void clampI32(const TaskData& _data);
+
+        /// Converts inputStreams[0] into outputStreams[0], floats are truncated and have to be in range.
+        void convertF32ToI32(const TaskData& _data);
+        void convertI32ToF32(const TaskData& _data);
+    }
 }
\ No newline at end of file
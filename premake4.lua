@@ -14,3 +14,48 @@ solution "Orbit"
          targetdir "bin/release"
          flags { "Optimize" }  
          
+
+   project "StreamingKernelsTest"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tests/StreamingKernelsTest.cpp" }
+      includedirs { "src" }
+      links { "Orbit" }
+
+      configuration "Debug"
+         targetdir "bin/debug"
+         flags { "Symbols" }
+
+      configuration "Release"
+         targetdir "bin/release"
+         flags { "Optimize" }
+
+   project "CriticalPathBenchmark"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tests/CriticalPathBenchmark.cpp" }
+      includedirs { "src" }
+      links { "Orbit" }
+
+      configuration "Debug"
+         targetdir "bin/debug"
+         flags { "Symbols" }
+
+      configuration "Release"
+         targetdir "bin/release"
+         flags { "Optimize" }
+
+   project "ForkJoinBenchmark"
+      kind "ConsoleApp"
+      language "C++"
+      files { "tests/ForkJoinBenchmark.cpp" }
+      includedirs { "src" }
+      links { "Orbit" }
+
+      configuration "Debug"
+         targetdir "bin/debug"
+         flags { "Symbols" }
+
+      configuration "Release"
+         targetdir "bin/release"
+         flags { "Optimize" }
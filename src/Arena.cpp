@@ -0,0 +1,69 @@
+#include "Arena.hpp"
+#include <cstdint>
+
+namespace orbit
+{
+    namespace
+    {
+        size_t alignOffset(const char* _memory, size_t _offset, size_t _alignment)
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(_memory) + _offset;
+            const uintptr_t aligned = (address + _alignment - 1) & ~static_cast<uintptr_t>(_alignment - 1);
+            return _offset + static_cast<size_t>(aligned - address);
+        }
+    }
+
+    LinearArena::LinearArena(size_t _capacity) : memory(new char[_capacity]), size(_capacity), offset(0), highWater(0) {}
+
+    LinearArena::~LinearArena()
+    {
+        delete[] memory;
+    }
+
+    void* LinearArena::allocate(size_t _size, size_t _alignment)
+    {
+        const size_t start = alignOffset(memory, offset, _alignment);
+        if (start > size || _size > size - start)
+        {
+            return nullptr;
+        }
+
+        offset = start + _size;
+        if (offset > highWater)
+        {
+            highWater = offset;
+        }
+        return memory + start;
+    }
+
+    FrameArena::FrameArena(size_t _capacity) : memory(new char[_capacity]), size(_capacity)
+    {
+        offset = 0;
+        highWater = 0;
+    }
+
+    FrameArena::~FrameArena()
+    {
+        delete[] memory;
+    }
+
+    void* FrameArena::allocate(size_t _size, size_t _alignment)
+    {
+        size_t current = offset.load(std::memory_order_relaxed);
+        size_t start;
+        do
+        {
+            start = alignOffset(memory, current, _alignment);
+            if (start > size || _size > size - start)
+            {
+                return nullptr;
+            }
+        } while (!offset.compare_exchange_weak(current, start + _size, std::memory_order_relaxed));
+
+        size_t peak = highWater.load(std::memory_order_relaxed);
+        while (start + _size > peak && !highWater.compare_exchange_weak(peak, start + _size, std::memory_order_relaxed))
+        {
+        }
+        return memory + start;
+    }
+}
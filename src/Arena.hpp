@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+namespace orbit
+{
+    /// Bump allocator owned by a single thread. Allocations are released all at once by rewinding or resetting the arena.
+    class LinearArena
+    {
+    public:
+        explicit LinearArena(size_t _capacity);
+        LinearArena(const LinearArena &) = delete;
+        ~LinearArena();
+
+        /// Returns \c nullptr once the arena is exhausted.
+        void* allocate(size_t _size, size_t _alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T* allocate(size_t _count)
+        {
+            return static_cast<T*>(allocate(sizeof(T) * _count, alignof(T)));
+        }
+
+        /// Everything allocated after \a mark() is released again by \a rewind().
+        size_t mark() const { return offset; }
+        void rewind(size_t _mark) { offset = _mark; }
+        void reset() { offset = 0; }
+
+        size_t used() const { return offset; }
+        size_t highWaterMark() const { return highWater; }
+        size_t capacity() const { return size; }
+
+    private:
+        char* memory;
+        size_t size;
+        size_t offset;
+        size_t highWater;
+    };
+
+    /// Bump allocator shared by all threads, allocations stay valid until the arena is reset.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t _capacity);
+        FrameArena(const FrameArena &) = delete;
+        ~FrameArena();
+
+        /// Returns \c nullptr once the arena is exhausted.
+        void* allocate(size_t _size, size_t _alignment = alignof(std::max_align_t));
+
+        template <typename T>
+        T* allocate(size_t _count)
+        {
+            return static_cast<T*>(allocate(sizeof(T) * _count, alignof(T)));
+        }
+
+        /// Must not be called while other threads allocate from the arena.
+        void reset() { offset.store(0, std::memory_order_relaxed); }
+
+        size_t used() const { return offset.load(std::memory_order_relaxed); }
+        size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+        size_t capacity() const { return size; }
+
+    private:
+        char* memory;
+        size_t size;
+        std::atomic<size_t> offset;
+        std::atomic<size_t> highWater;
+    };
+}
@@ -0,0 +1,289 @@
+#include "AsyncIo.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ORBIT_IO_URING
+#endif
+#endif
+
+#ifdef ORBIT_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace orbit
+{
+#ifdef ORBIT_IO_URING
+    namespace
+    {
+        const unsigned int RING_ENTRIES = 256;
+
+        template <typename T>
+        T* ringField(void* _ring, uint32_t _offset)
+        {
+            return reinterpret_cast<T*>(static_cast<char*>(_ring) + _offset);
+        }
+    }
+
+    AsyncIo::AsyncIo() : ring(-1), entries(0), submissionRing(MAP_FAILED), submissionRingSize(0),
+        completionRing(MAP_FAILED), completionRingSize(0), submissionEntries(MAP_FAILED), submissionEntriesSize(0)
+    {
+        inFlight = 0;
+
+        io_uring_params parameters;
+        memset(&parameters, 0, sizeof(parameters));
+        const int fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &parameters));
+        if (fd < 0)
+        {
+            return;
+        }
+
+        // plain read and write opcodes arrived together with the current position feature
+        if (!(parameters.features & IORING_FEAT_RW_CUR_POS))
+        {
+            close(fd);
+            return;
+        }
+
+        submissionRingSize = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned int);
+        completionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+        submissionEntriesSize = parameters.sq_entries * sizeof(io_uring_sqe);
+
+        submissionRing = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        completionRing = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        submissionEntries = mmap(nullptr, submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (submissionRing == MAP_FAILED || completionRing == MAP_FAILED || submissionEntries == MAP_FAILED)
+        {
+            close(fd);
+            release();
+            return;
+        }
+
+        submissionHead = ringField<unsigned int>(submissionRing, parameters.sq_off.head);
+        submissionTail = ringField<unsigned int>(submissionRing, parameters.sq_off.tail);
+        submissionMask = ringField<unsigned int>(submissionRing, parameters.sq_off.ring_mask);
+        submissionArray = ringField<unsigned int>(submissionRing, parameters.sq_off.array);
+        completionHead = ringField<unsigned int>(completionRing, parameters.cq_off.head);
+        completionTail = ringField<unsigned int>(completionRing, parameters.cq_off.tail);
+        completionMask = ringField<unsigned int>(completionRing, parameters.cq_off.ring_mask);
+        completionEntries = ringField<void>(completionRing, parameters.cq_off.cqes);
+
+        entries = parameters.sq_entries;
+        ring = fd;
+    }
+
+    AsyncIo::~AsyncIo()
+    {
+        release();
+        if (ring != -1)
+        {
+            close(ring);
+        }
+    }
+
+    void AsyncIo::release()
+    {
+        if (submissionEntries != MAP_FAILED)
+        {
+            munmap(submissionEntries, submissionEntriesSize);
+        }
+        if (completionRing != MAP_FAILED)
+        {
+            munmap(completionRing, completionRingSize);
+        }
+        if (submissionRing != MAP_FAILED)
+        {
+            munmap(submissionRing, submissionRingSize);
+        }
+
+        submissionEntries = completionRing = submissionRing = MAP_FAILED;
+    }
+
+    bool AsyncIo::submit(Operation _operation, int _fd, void* _buffer, size_t _size, uint64_t _offset, void* _userData)
+    {
+        if (ring == -1)
+        {
+            return false;
+        }
+
+        // the length of an entry has 32 bits, larger requests take the blocking path which splits them up
+        if (_size > UINT32_MAX)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(submitGuard);
+
+        // never have more requests in flight than the completion queue can hold
+        if (inFlight.load() >= entries)
+        {
+            return false;
+        }
+
+        const unsigned int tail = *submissionTail;
+        const unsigned int index = tail & *submissionMask;
+
+        io_uring_sqe* entry = static_cast<io_uring_sqe*>(submissionEntries) + index;
+        memset(entry, 0, sizeof(io_uring_sqe));
+        entry->opcode = _operation == READ ? IORING_OP_READ : IORING_OP_WRITE;
+        entry->fd = _fd;
+        entry->addr = reinterpret_cast<uintptr_t>(_buffer);
+        entry->len = static_cast<uint32_t>(_size);
+        entry->off = _offset;
+        entry->user_data = reinterpret_cast<uintptr_t>(_userData);
+
+        submissionArray[index] = index;
+        __atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+        ++inFlight;
+
+        if (syscall(__NR_io_uring_enter, ring, 1, 0, 0, nullptr, 0) < 1)
+        {
+            // the kernel did not take the entry, take it back so the caller can fall back
+            __atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+            --inFlight;
+            return false;
+        }
+        return true;
+    }
+
+    void AsyncIo::poll(std::vector<Completion>& _completions)
+    {
+        if (ring == -1 || inFlight.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(pollGuard, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
+        }
+
+        unsigned int head = *completionHead;
+        const unsigned int tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe* entry = static_cast<const io_uring_cqe*>(completionEntries) + (head & *completionMask);
+            Completion completion = { reinterpret_cast<void*>(static_cast<uintptr_t>(entry->user_data)), entry->res };
+            _completions.push_back(completion);
+            --inFlight;
+        }
+        __atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+    }
+#else
+    AsyncIo::AsyncIo() : ring(-1), entries(0)
+    {
+        inFlight = 0;
+    }
+
+    AsyncIo::~AsyncIo() {}
+
+    void AsyncIo::release() {}
+
+    bool AsyncIo::submit(Operation, int, void*, size_t, uint64_t, void*)
+    {
+        return false;
+    }
+
+    void AsyncIo::poll(std::vector<Completion>&) {}
+#endif
+
+    namespace
+    {
+        /// Largest number of bytes moved by one read or write call.
+        const size_t MAX_TRANSFER = size_t(1) << 30;
+
+        /// Runs \a _transfer on consecutive pieces of at most MAX_TRANSFER bytes until \a _size bytes are done or a piece
+        /// comes up short, returns the number of bytes transferred or the error of the first piece.
+        template <typename Transfer>
+        int64_t transferInPieces(size_t _size, Transfer _transfer)
+        {
+            size_t transferred = 0;
+            while (transferred != _size)
+            {
+                const size_t size = _size - transferred < MAX_TRANSFER ? _size - transferred : MAX_TRANSFER;
+                const int64_t result = _transfer(transferred, size);
+                if (result < 0)
+                {
+                    return transferred != 0 ? static_cast<int64_t>(transferred) : result;
+                }
+
+                transferred += static_cast<size_t>(result);
+                if (static_cast<size_t>(result) != size)
+                {
+                    break;
+                }
+            }
+            return static_cast<int64_t>(transferred);
+        }
+    }
+
+#ifdef _WIN32
+    int64_t AsyncIo::read(int _fd, void* _buffer, size_t _size, uint64_t _offset)
+    {
+        HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fd));
+        return transferInPieces(_size, [&](size_t _done, size_t _count) -> int64_t
+        {
+            OVERLAPPED position = {};
+            position.Offset = static_cast<DWORD>(_offset + _done);
+            position.OffsetHigh = static_cast<DWORD>((_offset + _done) >> 32);
+
+            DWORD transferred = 0;
+            if (!ReadFile(file, static_cast<char*>(_buffer) + _done, static_cast<DWORD>(_count), &transferred, &position) &&
+                GetLastError() != ERROR_HANDLE_EOF)
+            {
+                return -static_cast<int64_t>(GetLastError());
+            }
+            return transferred;
+        });
+    }
+
+    int64_t AsyncIo::write(int _fd, const void* _buffer, size_t _size, uint64_t _offset)
+    {
+        HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fd));
+        return transferInPieces(_size, [&](size_t _done, size_t _count) -> int64_t
+        {
+            OVERLAPPED position = {};
+            position.Offset = static_cast<DWORD>(_offset + _done);
+            position.OffsetHigh = static_cast<DWORD>((_offset + _done) >> 32);
+
+            DWORD transferred = 0;
+            if (!WriteFile(file, static_cast<const char*>(_buffer) + _done, static_cast<DWORD>(_count), &transferred, &position))
+            {
+                return -static_cast<int64_t>(GetLastError());
+            }
+            return transferred;
+        });
+    }
+#else
+    int64_t AsyncIo::read(int _fd, void* _buffer, size_t _size, uint64_t _offset)
+    {
+        return transferInPieces(_size, [&](size_t _done, size_t _count) -> int64_t
+        {
+            const ssize_t result = pread(_fd, static_cast<char*>(_buffer) + _done, _count, static_cast<off_t>(_offset + _done));
+            return result < 0 ? -errno : result;
+        });
+    }
+
+    int64_t AsyncIo::write(int _fd, const void* _buffer, size_t _size, uint64_t _offset)
+    {
+        return transferInPieces(_size, [&](size_t _done, size_t _count) -> int64_t
+        {
+            const ssize_t result = pwrite(_fd, static_cast<const char*>(_buffer) + _done, _count, static_cast<off_t>(_offset + _done));
+            return result < 0 ? -errno : result;
+        });
+    }
+#endif
+}
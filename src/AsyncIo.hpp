@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace orbit
+{
+    /// Asynchronous file I/O through io_uring. On systems without io_uring the ring is unavailable and callers fall back to
+    /// the blocking functions, which are run as regular tasks.
+    class AsyncIo
+    {
+    public:
+        enum Operation
+        {
+            READ,
+            WRITE,
+        };
+
+        struct Completion
+        {
+            void* userData;
+            int64_t result;
+        };
+
+        AsyncIo();
+        AsyncIo(const AsyncIo &) = delete;
+        ~AsyncIo();
+
+        bool isAvailable() const { return ring != -1; }
+
+        /// Submits a request, returns \c false if the ring is unavailable or full or the request is larger than 4 GiB.
+        bool submit(Operation _operation, int _fd, void* _buffer, size_t _size, uint64_t _offset, void* _userData);
+
+        /// Appends completed requests to \a _completions. Only one thread reaps at a time, others return right away.
+        void poll(std::vector<Completion>& _completions);
+
+        bool hasPendingRequests() const { return inFlight != 0; }
+
+        /// Blocking fallbacks, return the number of bytes transferred or a negative error code. Requests of any size are split
+        /// into pieces a single call can transfer.
+        static int64_t read(int _fd, void* _buffer, size_t _size, uint64_t _offset);
+        static int64_t write(int _fd, const void* _buffer, size_t _size, uint64_t _offset);
+
+    private:
+        void release();
+
+        int ring;
+        unsigned int entries;
+
+        void* submissionRing;
+        size_t submissionRingSize;
+        void* completionRing;
+        size_t completionRingSize;
+        void* submissionEntries;
+        size_t submissionEntriesSize;
+
+        unsigned int* submissionHead;
+        unsigned int* submissionTail;
+        unsigned int* submissionMask;
+        unsigned int* submissionArray;
+        unsigned int* completionHead;
+        unsigned int* completionTail;
+        unsigned int* completionMask;
+        void* completionEntries;
+
+        std::mutex submitGuard;
+        std::mutex pollGuard;
+        std::atomic<unsigned int> inFlight;
+    };
+}
@@ -0,0 +1,542 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "TaskCore.hpp"
+#include "TaskPool.hpp"
+#include "TaskQueue.hpp"
+#include "LockingQueue.hpp"
+
+namespace orbit
+{
+    /// A callable stored inside the task itself instead of on the heap, \a Size bytes are available for its captures.
+    template<size_t Size>
+    class InplaceKernel
+    {
+    public:
+        InplaceKernel() : invoke(nullptr), manage(nullptr) {}
+
+        template<typename Function, typename = typename std::enable_if<!std::is_same<Function, InplaceKernel>::value>::type>
+        InplaceKernel(Function _function) : invoke(&invokeFunction<Function>), manage(&manageFunction<Function>)
+        {
+            static_assert(sizeof(Function) <= Size, "the kernel captures more than the policy's kernel storage holds");
+            static_assert(alignof(Function) <= alignof(std::max_align_t), "the kernel is over-aligned");
+            new(&storage) Function(std::move(_function));
+        }
+
+        InplaceKernel(const InplaceKernel& _other) : invoke(_other.invoke), manage(_other.manage)
+        {
+            if (manage)
+            {
+                manage(&storage, &_other.storage);
+            }
+        }
+
+        InplaceKernel& operator=(const InplaceKernel& _other)
+        {
+            if (this != &_other)
+            {
+                reset();
+                invoke = _other.invoke;
+                manage = _other.manage;
+                if (manage)
+                {
+                    manage(&storage, &_other.storage);
+                }
+            }
+            return *this;
+        }
+
+        ~InplaceKernel()
+        {
+            reset();
+        }
+
+        explicit operator bool() const { return invoke != nullptr; }
+
+        void operator()(const TaskData& _data) const
+        {
+            invoke(&storage, _data);
+        }
+
+    private:
+        typedef typename std::aligned_storage<Size, alignof(std::max_align_t)>::type Storage;
+
+        /// Copies \a _source into \a _destination, or destroys \a _destination if \a _source is \c nullptr.
+        typedef void (*Manage)(Storage* _destination, const Storage* _source);
+        typedef void (*Invoke)(const Storage* _storage, const TaskData& _data);
+
+        template<typename Function>
+        static void invokeFunction(const Storage* _storage, const TaskData& _data)
+        {
+            (*reinterpret_cast<const Function*>(_storage))(_data);
+        }
+
+        template<typename Function>
+        static void manageFunction(Storage* _destination, const Storage* _source)
+        {
+            if (_source)
+            {
+                new(_destination) Function(*reinterpret_cast<const Function*>(_source));
+            }
+            else
+            {
+                reinterpret_cast<Function*>(_destination)->~Function();
+            }
+        }
+
+        void reset()
+        {
+            if (manage)
+            {
+                manage(&storage, nullptr);
+            }
+            invoke = nullptr;
+            manage = nullptr;
+        }
+
+        Storage storage;
+        Invoke invoke;
+        Manage manage;
+    };
+
+    /// Idle strategies decide what a thread without work does. \c relax is called between polls of a waiting or helping
+    /// thread, workers block on the queue for up to \c PARK_MILLISECONDS or relax instead if it is zero.
+    struct SpinIdle
+    {
+        static const int PARK_MILLISECONDS = 0;
+        static void relax() {}
+    };
+
+    struct YieldIdle
+    {
+        static const int PARK_MILLISECONDS = 0;
+        static void relax() { std::this_thread::yield(); }
+    };
+
+    struct BlockingIdle
+    {
+        static const int PARK_MILLISECONDS = 1000;
+        static void relax() { std::this_thread::yield(); }
+    };
+
+    /// Instrumentation which compiles away.
+    struct NoInstrumentation
+    {
+        void taskQueued() {}
+        void taskExecuted() {}
+        void taskHelped() {}
+    };
+
+    /// Counts queued and executed tasks, and how many of them ran on a thread helping while it waited.
+    struct CountingInstrumentation
+    {
+        CountingInstrumentation()
+        {
+            queued = 0;
+            executed = 0;
+            helped = 0;
+        }
+
+        void taskQueued() { queued.fetch_add(1, std::memory_order_relaxed); }
+        void taskExecuted() { executed.fetch_add(1, std::memory_order_relaxed); }
+        void taskHelped() { helped.fetch_add(1, std::memory_order_relaxed); }
+
+        std::atomic<size_t> queued;
+        std::atomic<size_t> executed;
+        std::atomic<size_t> helped;
+    };
+
+    /// The policy Scheduler is built on, other policies can derive from it and override single choices. The queue has to
+    /// provide push, a batch push, tryPop, tryWaitAndPop and notifyOne like LockingQueue.
+    struct DefaultSchedulerPolicy
+    {
+        static const unsigned int MAX_WORKER_THREAD_COUNT = configuration::MAX_WORKER_THREAD_COUNT;
+        static const unsigned int MAX_TASK_COUNT = configuration::MAX_TASK_COUNT;
+
+        typedef orbit::Kernel Kernel;
+
+        template<typename T>
+        using Queue = LockingQueue<T>;
+
+        typedef NoInstrumentation Instrumentation;
+        typedef BlockingIdle Idle;
+    };
+
+    /// Header-only fork/join scheduler configured at compile time. The policy chooses the pool capacity, the queue, how
+    /// kernels are stored, instrumentation and what idle threads do, so adding, running and finishing tasks can inline into
+    /// the caller. Kernels of a standalone BasicScheduler get no scratch or frame arena.
+    ///
+    /// Scheduler holds a BasicScheduler<DefaultSchedulerPolicy> and shares its task pool, queue and streaming split and the
+    /// way tasks are executed and finished. It passes itself as the front end to those calls, which has to provide
+    /// runKernel(Task*), taskFinished(Task*), queueTask(Task*) and helpWithWork(), and adds timers, I/O, arenas and its
+    /// elastic worker pool on top.
+    template<typename Policy>
+    class BasicScheduler
+    {
+    public:
+        typedef typename Policy::Kernel Kernel;
+        typedef typename Policy::Instrumentation Instrumentation;
+        typedef typename Policy::Idle Idle;
+        typedef BasicTask<Kernel> Task;
+        typedef BasicTaskPool<Task, Policy::MAX_TASK_COUNT> TaskPool;
+        typedef BasicTaskQueue<Task, Policy> TaskQueue;
+
+        BasicScheduler() : frontend(*this)
+        {
+            shouldRun = true;
+        }
+
+        BasicScheduler(const BasicScheduler &) = delete;
+
+        ~BasicScheduler()
+        {
+            shouldRun = false;
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        /// Starts the workers of a standalone scheduler, Scheduler runs its own worker pool on the queue instead.
+        void initialise(unsigned int _cores)
+        {
+            const unsigned int count = _cores < Policy::MAX_WORKER_THREAD_COUNT ? _cores : Policy::MAX_WORKER_THREAD_COUNT;
+            for (unsigned int i(0); i != count; ++i)
+            {
+                threads.push_back(std::thread(&BasicScheduler::work, this));
+            }
+        }
+
+        TaskId addTask(void* _kernelData, Kernel _kernel)
+        {
+            Task* task = taskPool.obtainTask();
+            task->kernel = std::move(_kernel);
+            task->taskData.kernelData = _kernelData;
+            return taskPool.getTaskId(task);
+        }
+
+        TaskId addAndRunTask(void* _kernelData, Kernel _kernel)
+        {
+            Task* task = taskPool.obtainTask();
+            task->kernel = std::move(_kernel);
+            task->taskData.kernelData = _kernelData;
+
+            // the task may be finished and recycled as soon as it is queued, so take its id first
+            const TaskId id = taskPool.getTaskId(task);
+            queueTask(task);
+            return id;
+        }
+
+        TaskId addEmptyTask()
+        {
+            return addTask(nullptr, Kernel());
+        }
+
+        /// Splits \a _elementCount elements into chunks of about \a _elementsPerTask and runs \a _kernel on each of them,
+        /// the returned root has to be run like with Scheduler::addStreamingTask. A \a _boundaryAlignment in bytes rounds
+        /// chunk boundaries so every stream of a chunk starts aligned, leftover elements go to a head and a tail chunk.
+        /// \a _cancellation, if given, becomes the parent token of the root before any chunk is queued.
+        TaskId addStreamingTask(Kernel _kernel, void* _kernelData,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0)
+        {
+            return addStreamingTask(frontend, _kernel, _kernelData, _inputs, _outputs, _streamCount, _elementCount, _elementsPerTask, _boundaryAlignment);
+        }
+
+        template<typename Frontend>
+        TaskId addStreamingTask(Frontend& _frontend, const Kernel& _kernel, void* _kernelData,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment,
+            const CancellationToken* _cancellation = nullptr)
+        {
+            // chunk boundaries are placed on multiples of the granularity, so every stream of a chunk starts aligned
+            size_t granularity = 1;
+            size_t headCount = 0;
+            if (_boundaryAlignment > 1)
+            {
+                for (size_t s = 0; s != _streamCount; ++s)
+                {
+                    granularity = leastCommonMultiple(granularity, alignedElementStep(_inputs[s].elementStride, _boundaryAlignment));
+                    granularity = leastCommonMultiple(granularity, alignedElementStep(_outputs[s].elementStride, _boundaryAlignment));
+                }
+
+                // the head chunk takes the elements up to the first boundary at which all streams are aligned
+                for (size_t head = 0; head < granularity && head < _elementCount; ++head)
+                {
+                    bool aligned = true;
+                    for (size_t s = 0; s != _streamCount && aligned; ++s)
+                    {
+                        aligned = isAligned(static_cast<char*>(_inputs[s].data) + head*_inputs[s].elementStride, _boundaryAlignment) &&
+                            isAligned(static_cast<char*>(_outputs[s].data) + head*_outputs[s].elementStride, _boundaryAlignment);
+                    }
+
+                    if (aligned)
+                    {
+                        headCount = head;
+                        break;
+                    }
+                }
+            }
+
+            // split the task into several subtasks, according to the size of the input/output streams
+            const size_t bodyCount = _elementCount - headCount;
+            const size_t N = determineNumberOfTasks(bodyCount, _elementsPerTask);
+            // never less than one granule, a coarse alignment must not fold the whole body into the tail
+            const size_t perElementCount = std::max((bodyCount / N) / granularity * granularity, granularity);
+            const size_t chunkCount = perElementCount != 0 ? bodyCount / perElementCount : 0;
+            const size_t tailCount = bodyCount - chunkCount * perElementCount;
+
+            // add a root task used for synchronisation
+            Task* root = taskPool.obtainTask();
+            root->cancellation.parent = _cancellation;
+            TaskId::Offset rootOffset = taskPool.getTaskOffset(root);
+            TaskControl& rootControl = taskPool.getControl(rootOffset);
+            rootControl.openTasks = chunkCount + (headCount != 0 ? 1 : 0) + (tailCount != 0 ? 1 : 0) + 1;
+
+            // the root cannot finish before it is run, so its id stays valid while the chunks are queued
+            const TaskId rootId = taskPool.getTaskId(root);
+            const size_t alignmentLimit = _boundaryAlignment > configuration::CACHE_LINE_SIZE ? _boundaryAlignment : configuration::CACHE_LINE_SIZE;
+
+            size_t first = 0;
+            const size_t chunkEnd = headCount + chunkCount * perElementCount;
+            while (first != _elementCount)
+            {
+                const size_t count = (first < headCount) ? headCount : (first < chunkEnd ? perElementCount : tailCount);
+
+                Task* task = taskPool.obtainTask();
+                task->kernel = _kernel;
+                taskPool.getControl(task).parent = rootOffset;
+                task->cancellation.parent = &root->cancellation;
+                task->taskData.kernelData = _kernelData;
+
+                TaskData::StreamingData& streamingData = task->taskData.specificData.streamingData;
+                streamingData.elementCount = count;
+                streamingData.alignment = alignmentLimit;
+                for (size_t s = 0; s != 3; ++s)
+                {
+                    void* input = nullptr;
+                    void* output = nullptr;
+                    if (s < _streamCount)
+                    {
+                        input = static_cast<char*>(_inputs[s].data) + first*_inputs[s].elementStride;
+                        output = static_cast<char*>(_outputs[s].data) + first*_outputs[s].elementStride;
+
+                        streamingData.alignment = alignmentOf(input, streamingData.alignment);
+                        streamingData.alignment = alignmentOf(output, streamingData.alignment);
+                    }
+
+                    streamingData.inputStreams[s] = input;
+                    streamingData.outputStreams[s] = output;
+                }
+
+                _frontend.queueTask(task);
+                first += count;
+            }
+
+            return rootId;
+        }
+
+        void addChild(const TaskId& _parent, const TaskId& _child)
+        {
+            taskPool.getControl(_parent.offset).openTasks++;
+            taskPool.getControl(_child.offset).parent = _parent.offset;
+            taskPool.getTask(_child.offset)->cancellation.parent = &taskPool.getTask(_parent.offset)->cancellation;
+        }
+
+        void runTask(const TaskId& _id)
+        {
+            queueTask(taskPool.getTask(_id.offset));
+        }
+
+        /// Cancels a task and every task beneath it. Queued tasks of a cancelled tree are finished without running their kernel.
+        void cancel(const TaskId& _id)
+        {
+            if (taskPool.getControl(_id.offset).generation == static_cast<int32_t>(_id.generation))
+            {
+                // children poll the token chain, so flagging the task is enough to cancel the whole tree
+                taskPool.getTask(_id.offset)->cancellation.cancelled.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        bool isTaskFinished(const TaskId& _id) const
+        {
+            return taskPool.isTaskFinished(_id);
+        }
+
+        /// Waits for the task to finish, the calling thread works on other tasks in the meantime.
+        void wait(const TaskId& _id)
+        {
+            while (!isTaskFinished(_id))
+            {
+                helpWithWork();
+            }
+        }
+
+        const Instrumentation& getInstrumentation() const { return instrumentation; }
+
+        TaskPool& getTaskPool() { return taskPool; }
+        TaskQueue& getQueue() { return queue; }
+
+        void queueTask(Task* _task)
+        {
+            instrumentation.taskQueued();
+            queue.queueTask(_task);
+        }
+
+        /// Runs the task once all its children have finished and finishes it, \a _frontend helps with other work meanwhile.
+        template<typename Frontend>
+        void workOnTask(Frontend& _frontend, Task* _task)
+        {
+            while (!canExecuteTask(_task))
+            {
+                // the task cannot be executed at this time, work on another item
+                _frontend.helpWithWork();
+            }
+
+            _frontend.runKernel(_task);
+            finishTask(_frontend, _task);
+        }
+
+        /// Counts the task down and, once it and all its children are done, returns it to the pool and finishes its parent.
+        template<typename Frontend>
+        void finishTask(Frontend& _frontend, Task* _task)
+        {
+            TaskControl& control = taskPool.getControl(_task);
+            if (--control.openTasks == 0)
+            {
+                _frontend.taskFinished(_task);
+
+                // this task has finished completely, remove it before telling the parent so the slot is free again
+                const TaskId::Offset parent = control.parent;
+                taskPool.returnTask(_task);
+                if (parent != Task::NO_PARENT)
+                {
+                    finishTask(_frontend, taskPool.getTask(parent));
+                }
+            }
+        }
+
+        bool canExecuteTask(Task* _task)
+        {
+            const TaskControl& control = taskPool.getControl(_task);
+            return control.parent == Task::NO_PARENT || control.openTasks == 1;
+        }
+
+        static size_t determineNumberOfTasks(size_t _elementCount, size_t _elementsPerTask)
+        {
+            const size_t numberOfTasks = _elementCount / _elementsPerTask;
+            return numberOfTasks != 0 ? numberOfTasks : 1;
+        }
+
+    private:
+        /// Front end of a standalone scheduler, kernels run right away on the calling thread.
+        struct DirectFrontend
+        {
+            explicit DirectFrontend(BasicScheduler& _scheduler) : scheduler(_scheduler) {}
+
+            void runKernel(Task* _task)
+            {
+                // execute the kernel unless the task tree has been cancelled, the task is finished either way
+                if (_task->kernel && !_task->cancellation.isCancelled())
+                {
+                    _task->kernel(_task->taskData);
+                    scheduler.instrumentation.taskExecuted();
+                }
+            }
+
+            void taskFinished(Task*) {}
+            void queueTask(Task* _task) { scheduler.queueTask(_task); }
+            void helpWithWork() { scheduler.helpWithWork(); }
+
+            BasicScheduler& scheduler;
+        };
+
+        static size_t greatestCommonDivisor(size_t _a, size_t _b)
+        {
+            while (_b != 0)
+            {
+                const size_t remainder = _a % _b;
+                _a = _b;
+                _b = remainder;
+            }
+            return _a;
+        }
+
+        static size_t leastCommonMultiple(size_t _a, size_t _b)
+        {
+            return _a / greatestCommonDivisor(_a, _b) * _b;
+        }
+
+        /// Returns the number of elements after which a stream has advanced by a multiple of \a _alignment bytes.
+        static size_t alignedElementStep(size_t _stride, size_t _alignment)
+        {
+            return _stride != 0 ? _alignment / greatestCommonDivisor(_alignment, _stride) : 1;
+        }
+
+        static bool isAligned(const void* _data, size_t _alignment)
+        {
+            return reinterpret_cast<uintptr_t>(_data) % _alignment == 0;
+        }
+
+        /// Returns the largest power of two up to \a _limit which \a _data is aligned to.
+        static size_t alignmentOf(const void* _data, size_t _limit)
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(_data);
+            const size_t lowestBit = static_cast<size_t>(address & (~address + 1));
+            return (lowestBit == 0 || lowestBit > _limit) ? _limit : lowestBit;
+        }
+
+        void work()
+        {
+            while (shouldRun.load())
+            {
+                Task* task = queue.getAvailableTask();
+                if (!task && Idle::PARK_MILLISECONDS != 0)
+                {
+                    task = queue.waitUntilTaskIsAvailable(Idle::PARK_MILLISECONDS);
+                }
+
+                if (task)
+                {
+                    workOnTask(frontend, task);
+                }
+                else if (Idle::PARK_MILLISECONDS == 0)
+                {
+                    Idle::relax();
+                }
+            }
+        }
+
+        void helpWithWork()
+        {
+            Task* task = queue.getAvailableTask();
+            if (task)
+            {
+                instrumentation.taskHelped();
+                workOnTask(frontend, task);
+            }
+            else
+            {
+                Idle::relax();
+            }
+        }
+
+        TaskPool taskPool;
+        TaskQueue queue;
+        Instrumentation instrumentation;
+        DirectFrontend frontend;
+
+        std::atomic<bool> shouldRun;
+        std::vector<std::thread> threads;
+    };
+}
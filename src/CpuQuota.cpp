@@ -0,0 +1,212 @@
+#include "CpuQuota.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace orbit
+{
+#ifdef _WIN32
+    unsigned int detectCpuQuota()
+    {
+        return 0;
+    }
+#else
+    namespace
+    {
+        unsigned int coresFor(long long _quota, long long _period)
+        {
+            if (_quota <= 0 || _period <= 0)
+            {
+                return 0;
+            }
+            return static_cast<unsigned int>((_quota + _period - 1) / _period);
+        }
+
+        bool readValue(const std::string& _path, long long& _value)
+        {
+            FILE* file = std::fopen(_path.c_str(), "r");
+            if (!file)
+            {
+                return false;
+            }
+            const bool read = std::fscanf(file, "%lld", &_value) == 1;
+            std::fclose(file);
+            return read;
+        }
+
+        /// Returns the quota of a single cgroup directory in cores, 0 if it has none.
+        unsigned int quotaOf(const std::string& _directory, bool _unified)
+        {
+            long long quota = 0;
+            long long period = 0;
+            if (_unified)
+            {
+                // cgroup v2 keeps quota and period in one file, an unlimited quota reads "max"
+                FILE* file = std::fopen((_directory + "/cpu.max").c_str(), "r");
+                if (!file)
+                {
+                    return 0;
+                }
+                const bool limited = std::fscanf(file, "%lld %lld", &quota, &period) == 2;
+                std::fclose(file);
+                return limited ? coresFor(quota, period) : 0;
+            }
+
+            // cgroup v1, -1 stands for an unlimited quota
+            if (readValue(_directory + "/cpu.cfs_quota_us", quota) && readValue(_directory + "/cpu.cfs_period_us", period))
+            {
+                return coresFor(quota, period);
+            }
+            return 0;
+        }
+
+        std::vector<std::string> split(const std::string& _text, char _separator)
+        {
+            std::vector<std::string> fields;
+            size_t first = 0;
+            for (size_t separator = _text.find(_separator); separator != std::string::npos; separator = _text.find(_separator, first))
+            {
+                fields.push_back(_text.substr(first, separator - first));
+                first = separator + 1;
+            }
+            fields.push_back(_text.substr(first));
+            return fields;
+        }
+
+        bool contains(const std::vector<std::string>& _fields, const char* _field)
+        {
+            for (const std::string& field : _fields)
+            {
+                if (field == _field)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Reads the lines of a file under /proc, without their line breaks.
+        std::vector<std::string> readLines(const char* _path)
+        {
+            std::vector<std::string> lines;
+            FILE* file = std::fopen(_path, "r");
+            if (!file)
+            {
+                return lines;
+            }
+
+            char line[4096];
+            while (std::fgets(line, sizeof(line), file))
+            {
+                line[std::strcspn(line, "\n")] = '\0';
+                lines.push_back(line);
+            }
+            std::fclose(file);
+            return lines;
+        }
+
+        /// Finds the cgroup of the process in the unified hierarchy or in the v1 hierarchy of the cpu controller.
+        bool findCgroup(bool _unified, std::string& _path)
+        {
+            // hierarchy-ID:controller-list:cgroup-path, the unified hierarchy has the ID 0 and no controllers
+            for (const std::string& line : readLines("/proc/self/cgroup"))
+            {
+                const size_t first = line.find(':');
+                const size_t second = first != std::string::npos ? line.find(':', first + 1) : std::string::npos;
+                if (second == std::string::npos)
+                {
+                    continue;
+                }
+
+                const std::string controllers = line.substr(first + 1, second - first - 1);
+                const bool matches = _unified ? line.compare(0, first, "0") == 0 && controllers.empty() :
+                    contains(split(controllers, ','), "cpu");
+                if (matches)
+                {
+                    _path = line.substr(second + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Finds where the hierarchy is mounted, \a _root is the cgroup the mount point shows, such as the container's own
+        /// cgroup inside a cgroup namespace or a bind mount.
+        bool findMount(bool _unified, std::string& _root, std::string& _mountPoint)
+        {
+            // ID parent major:minor root mount-point options [optional fields...] - type source super-options
+            for (const std::string& line : readLines("/proc/self/mountinfo"))
+            {
+                const std::vector<std::string> fields = split(line, ' ');
+                size_t separator = 6;
+                while (separator < fields.size() && fields[separator] != "-")
+                {
+                    ++separator;
+                }
+                if (separator + 3 >= fields.size())
+                {
+                    continue;
+                }
+
+                const std::string& type = fields[separator + 1];
+                const bool matches = _unified ? type == "cgroup2" :
+                    type == "cgroup" && contains(split(fields[separator + 3], ','), "cpu");
+                if (matches)
+                {
+                    _root = fields[3];
+                    _mountPoint = fields[4];
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    unsigned int detectCpuQuota()
+    {
+        // hybrid setups mount the unified hierarchy without the cpu controller, so v1 is checked if v2 has no quota
+        const bool hierarchies[] = { true, false };
+        for (bool unified : hierarchies)
+        {
+            std::string path;
+            std::string root;
+            std::string mountPoint;
+            if (!findCgroup(unified, path) || !findMount(unified, root, mountPoint))
+            {
+                continue;
+            }
+
+            // the cgroup path starts at the root of the hierarchy, the mount point may show only a part of it
+            if (root != "/" && path.compare(0, root.size(), root) == 0)
+            {
+                path = path.substr(root.size());
+            }
+            std::string directory = mountPoint + (path == "/" ? "" : path);
+
+            // the cgroup of the process and every cgroup above it up to the mount point may set a quota, the tightest wins
+            unsigned int cores = 0;
+            for (;;)
+            {
+                const unsigned int quota = quotaOf(directory, unified);
+                if (quota != 0 && (cores == 0 || quota < cores))
+                {
+                    cores = quota;
+                }
+                if (directory.size() <= mountPoint.size())
+                {
+                    break;
+                }
+                directory.erase(directory.rfind('/'));
+            }
+
+            if (cores != 0)
+            {
+                return cores;
+            }
+        }
+        return 0;
+    }
+#endif
+}
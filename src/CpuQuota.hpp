@@ -0,0 +1,8 @@
+#pragma once
+
+namespace orbit
+{
+    /// Number of cores the process may use according to the CPU quota of its own cgroup and the cgroups above it (v2 or
+    /// v1), rounded up. Returns 0 if no quota is set or it cannot be determined, e.g. outside of Linux.
+    unsigned int detectCpuQuota();
+}
@@ -0,0 +1,34 @@
+#include "DurationHistory.hpp"
+
+namespace orbit
+{
+    DurationHistory::DurationHistory()
+    {
+        for (Entry& entry : entries)
+        {
+            entry.key = 0;
+            entry.nanoseconds = 0;
+        }
+    }
+
+    void DurationHistory::record(uint64_t _key, uint64_t _nanoseconds)
+    {
+        Entry& entry = entries[_key % ENTRY_COUNT];
+        if (entry.key.load(std::memory_order_relaxed) != _key)
+        {
+            entry.key.store(_key, std::memory_order_relaxed);
+            entry.nanoseconds.store(_nanoseconds, std::memory_order_relaxed);
+            return;
+        }
+
+        // an exponential moving average, racing updates from several workers only lose a sample
+        const uint64_t average = entry.nanoseconds.load(std::memory_order_relaxed);
+        entry.nanoseconds.store((average * 7 + _nanoseconds) / 8, std::memory_order_relaxed);
+    }
+
+    uint64_t DurationHistory::estimate(uint64_t _key) const
+    {
+        const Entry& entry = entries[_key % ENTRY_COUNT];
+        return entry.key.load(std::memory_order_relaxed) == _key ? entry.nanoseconds.load(std::memory_order_relaxed) : 0;
+    }
+}
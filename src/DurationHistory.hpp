@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace orbit
+{
+    /// Running average of kernel durations, keyed by kernel label or identity. The table is direct mapped, a key which
+    /// collides with another one simply replaces it.
+    class DurationHistory
+    {
+    public:
+        DurationHistory();
+
+        void record(uint64_t _key, uint64_t _nanoseconds);
+
+        /// Returns the expected duration in nanoseconds, zero for unknown keys.
+        uint64_t estimate(uint64_t _key) const;
+
+    private:
+        static const unsigned int ENTRY_COUNT = 1024;
+
+        struct Entry
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> nanoseconds;
+        };
+
+        Entry entries[ENTRY_COUNT];
+    };
+}
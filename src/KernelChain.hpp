@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+
+#include "TaskCore.hpp"
+
+namespace orbit
+{
+    /// A sequence of kernels which Scheduler::addFusedStreamingTask runs over the same streams in a single pass. Every
+    /// chunk runs all kernels up to the next barrier back to back while its data is still in cache.
+    class KernelChain
+    {
+    public:
+        struct Stage
+        {
+            Kernel kernel;
+            void* kernelData;
+        };
+        typedef std::vector<Stage> Segment;
+
+        KernelChain() : segments(1) {}
+
+        /// Appends a kernel, it runs on a chunk after the kernels added before it.
+        KernelChain& add(Kernel _kernel, void* _kernelData)
+        {
+            Stage stage;
+            stage.kernel = _kernel;
+            stage.kernelData = _kernelData;
+            segments.back().push_back(stage);
+            return *this;
+        }
+
+        /// Kernels added after a barrier only start once every chunk has run the kernels before it, e.g. because they
+        /// need a result gathered over the whole stream.
+        KernelChain& barrier()
+        {
+            if (!segments.back().empty())
+            {
+                segments.push_back(Segment());
+            }
+            return *this;
+        }
+
+        const std::vector<Segment>& getSegments() const { return segments; }
+
+    private:
+        std::vector<Segment> segments;
+    };
+}
@@ -6,6 +6,18 @@
 namespace orbit
 {
     template<typename T>
+    const T& nextElement(const std::queue<T>& _queue)
+    {
+        return _queue.front();
+    }
+
+    template<typename T, typename Container, typename Compare>
+    const T& nextElement(const std::priority_queue<T, Container, Compare>& _queue)
+    {
+        return _queue.top();
+    }
+
+    template<typename T, typename Queue = std::queue<T>>
     class LockingQueue
     {
     public:
@@ -18,6 +30,32 @@ namespace orbit
             signal.notify_one();
         }
 
+        void push(T const* _data, size_t _count)
+        {
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                for (size_t i = 0; i != _count; ++i)
+                {
+                    queue.push(_data[i]);
+                }
+            }
+
+            if (_count > 1)
+            {
+                signal.notify_all();
+            }
+            else
+            {
+                signal.notify_one();
+            }
+        }
+
+        /// Wakes up one waiting thread without pushing any data.
+        void notifyOne()
+        {
+            signal.notify_one();
+        }
+
         bool empty() const
         {
             std::lock_guard<std::mutex> lock(guard);
@@ -32,7 +70,7 @@ namespace orbit
                 return false;
             }
 
-            _value = queue.front();
+            _value = nextElement(queue);
             queue.pop();
             return true;
         }
@@ -45,7 +83,7 @@ namespace orbit
                 signal.wait(lock);
             }
 
-            _value = queue.front();
+            _value = nextElement(queue);
             queue.pop();
         }
 
@@ -58,13 +96,13 @@ namespace orbit
                 return false;
             }
 
-            _value = queue.front();
+            _value = nextElement(queue);
             queue.pop();
             return true;
         }
 
     private:
-        std::queue<T> queue;
+        Queue queue;
         mutable std::mutex guard;
         std::condition_variable signal;
     };
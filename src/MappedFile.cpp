@@ -0,0 +1,203 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace orbit
+{
+#ifdef _WIN32
+    MappedFile::MappedFile() : memory(nullptr), length(0), opened(false), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+#else
+    MappedFile::MappedFile() : memory(nullptr), length(0), opened(false), file(-1) {}
+#endif
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::openForReading(const char* _path)
+    {
+        close();
+        file = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+        {
+            close();
+            return false;
+        }
+
+        length = static_cast<size_t>(size.QuadPart);
+        return map(false);
+    }
+
+    bool MappedFile::createForWriting(const char* _path, size_t _size)
+    {
+        close();
+        file = CreateFileA(_path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            close();
+            return false;
+        }
+
+        length = _size;
+        return map(true);
+    }
+
+    bool MappedFile::map(bool _writable)
+    {
+        if (length != 0)
+        {
+            const DWORD protection = _writable ? PAGE_READWRITE : PAGE_READONLY;
+            const ULONGLONG size = length;
+            mapping = CreateFileMappingA(file, nullptr, protection, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+            memory = mapping ? MapViewOfFile(mapping, _writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, length) : nullptr;
+            if (!memory)
+            {
+                close();
+                return false;
+            }
+        }
+
+        opened = true;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (memory)
+        {
+            UnmapViewOfFile(memory);
+        }
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+
+        memory = nullptr;
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+        length = 0;
+        opened = false;
+    }
+
+    void MappedFile::advise(size_t, size_t, Advice) const
+    {
+        // there is no portable equivalent of madvise, the sequential scan flag has to do
+    }
+
+    void MappedFile::flush(size_t _offset, size_t _length) const
+    {
+        if (memory && _offset < length)
+        {
+            FlushViewOfFile(static_cast<char*>(memory) + _offset, _length < length - _offset ? _length : length - _offset);
+        }
+    }
+#else
+    bool MappedFile::openForReading(const char* _path)
+    {
+        close();
+        file = ::open(_path, O_RDONLY);
+        struct stat status;
+        if (file == -1 || fstat(file, &status) != 0)
+        {
+            close();
+            return false;
+        }
+
+        length = static_cast<size_t>(status.st_size);
+        return map(false);
+    }
+
+    bool MappedFile::createForWriting(const char* _path, size_t _size)
+    {
+        close();
+        file = ::open(_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file == -1 || ftruncate(file, static_cast<off_t>(_size)) != 0)
+        {
+            close();
+            return false;
+        }
+
+        length = _size;
+        return map(true);
+    }
+
+    bool MappedFile::map(bool _writable)
+    {
+        if (length != 0)
+        {
+            const int protection = _writable ? PROT_READ | PROT_WRITE : PROT_READ;
+            memory = mmap(nullptr, length, protection, MAP_SHARED, file, 0);
+            if (memory == MAP_FAILED)
+            {
+                memory = nullptr;
+                close();
+                return false;
+            }
+        }
+
+        opened = true;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (memory)
+        {
+            munmap(memory, length);
+        }
+        if (file != -1)
+        {
+            ::close(file);
+        }
+
+        memory = nullptr;
+        file = -1;
+        length = 0;
+        opened = false;
+    }
+
+    void MappedFile::advise(size_t _offset, size_t _length, Advice _advice) const
+    {
+        if (!memory || _offset >= length)
+        {
+            return;
+        }
+
+        // madvise wants a page aligned start, round it down and extend the range to match
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t start = _offset / pageSize * pageSize;
+        const size_t end = _length < length - _offset ? _offset + _length : length;
+
+        madvise(static_cast<char*>(memory) + start, end - start, _advice == WILL_NEED ? MADV_WILLNEED : MADV_DONTNEED);
+    }
+
+    void MappedFile::flush(size_t _offset, size_t _length) const
+    {
+        if (!memory || _offset >= length)
+        {
+            return;
+        }
+
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t start = _offset / pageSize * pageSize;
+        const size_t end = _length < length - _offset ? _offset + _length : length;
+
+        msync(static_cast<char*>(memory) + start, end - start, MS_ASYNC);
+    }
+#endif
+}
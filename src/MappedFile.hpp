@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+
+namespace orbit
+{
+    /// A file mapped into memory, used as source or destination of Scheduler::addMappedStreamingTask.
+    class MappedFile
+    {
+    public:
+        enum Advice
+        {
+            WILL_NEED,
+            DONT_NEED,
+        };
+
+        MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        ~MappedFile();
+
+        /// Maps an existing file read-only, returns \c false if it cannot be opened or mapped.
+        bool openForReading(const char* _path);
+
+        /// Creates or truncates a file of \a _size bytes and maps it writable.
+        bool createForWriting(const char* _path, size_t _size);
+
+        void close();
+
+        /// Hints the operating system about the use of a range, the range is widened to whole pages.
+        void advise(size_t _offset, size_t _length, Advice _advice) const;
+
+        /// Starts writing back modified pages of a range without waiting for it.
+        void flush(size_t _offset, size_t _length) const;
+
+        bool isOpen() const { return opened; }
+        void* data() const { return memory; }
+        size_t size() const { return length; }
+
+    private:
+        bool map(bool _writable);
+
+        void* memory;
+        size_t length;
+        bool opened;
+#ifdef _WIN32
+        void* file;
+        void* mapping;
+#else
+        int file;
+#endif
+    };
+}
@@ -0,0 +1,136 @@
+#include "PerfCounters.hpp"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace orbit
+{
+    PerfCounters::PerfCounters() : leader(-1), openCount(0)
+    {
+        for (int i = 0; i != COUNTER_COUNT; ++i)
+        {
+            descriptors[i] = -1;
+            positions[i] = -1;
+        }
+    }
+
+    PerfCounters::~PerfCounters()
+    {
+        close();
+    }
+
+#ifdef __linux__
+    namespace
+    {
+        int openEvent(uint32_t _type, uint64_t _config, int _groupLeader)
+        {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = _type;
+            attributes.config = _config;
+            attributes.read_format = PERF_FORMAT_GROUP;
+            attributes.disabled = _groupLeader == -1 ? 1 : 0;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            // the calling thread on any CPU
+            return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, _groupLeader, 0));
+        }
+    }
+
+    bool PerfCounters::open()
+    {
+        close();
+
+        const uint64_t configs[COUNTER_COUNT] =
+        {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        leader = openEvent(PERF_TYPE_HARDWARE, configs[CYCLES], -1);
+        if (leader == -1)
+        {
+            return false;
+        }
+        descriptors[CYCLES] = leader;
+        positions[CYCLES] = openCount++;
+
+        // the remaining counters are optional, virtual machines often lack some of them
+        for (int i = CYCLES + 1; i != COUNTER_COUNT; ++i)
+        {
+            descriptors[i] = openEvent(PERF_TYPE_HARDWARE, configs[i], leader);
+            if (descriptors[i] != -1)
+            {
+                positions[i] = openCount++;
+            }
+        }
+
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        owner = std::this_thread::get_id();
+        return true;
+    }
+
+    void PerfCounters::close()
+    {
+        for (int i = 0; i != COUNTER_COUNT; ++i)
+        {
+            if (descriptors[i] != -1)
+            {
+                ::close(descriptors[i]);
+            }
+            descriptors[i] = -1;
+            positions[i] = -1;
+        }
+        leader = -1;
+        openCount = 0;
+        owner = std::thread::id();
+    }
+
+    bool PerfCounters::read(Sample& _sample) const
+    {
+        if (leader == -1)
+        {
+            return false;
+        }
+
+        // with PERF_FORMAT_GROUP the group reads as its size followed by the values in the order they were opened
+        uint64_t buffer[1 + COUNTER_COUNT];
+        const ssize_t size = ::read(leader, buffer, sizeof(buffer));
+        if (size < static_cast<ssize_t>(sizeof(uint64_t)) || buffer[0] != static_cast<uint64_t>(openCount))
+        {
+            return false;
+        }
+
+        for (int i = 0; i != COUNTER_COUNT; ++i)
+        {
+            _sample.values[i] = positions[i] != -1 ? buffer[1 + positions[i]] : 0;
+        }
+        return true;
+    }
+#else
+    bool PerfCounters::open()
+    {
+        return false;
+    }
+
+    void PerfCounters::close()
+    {
+    }
+
+    bool PerfCounters::read(Sample&) const
+    {
+        return false;
+    }
+#endif
+}
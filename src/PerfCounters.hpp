@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <thread>
+
+namespace orbit
+{
+    /// Hardware counters summed over every run of a kernel, see Scheduler::enablePerfCounters.
+    struct KernelCounters
+    {
+        /// Label of the kernel's tasks, \c nullptr if they were not labelled.
+        const char* label;
+        uint64_t key;
+        uint64_t runs;
+
+        uint64_t cycles;
+        uint64_t instructions;
+        uint64_t llcMisses;
+        uint64_t branchMisses;
+    };
+
+    /// A group of hardware counters opened through perf_event_open, counting the thread which opened it. Counters the CPU
+    /// or the virtual machine does not offer read as zero, without perf events (outside of Linux, or when
+    /// perf_event_paranoid forbids them) the group cannot be opened at all.
+    class PerfCounters
+    {
+    public:
+        enum Counter
+        {
+            CYCLES,
+            INSTRUCTIONS,
+            LLC_MISSES,
+            BRANCH_MISSES,
+            COUNTER_COUNT,
+        };
+
+        struct Sample
+        {
+            uint64_t values[COUNTER_COUNT];
+        };
+
+        PerfCounters();
+        PerfCounters(const PerfCounters &) = delete;
+        ~PerfCounters();
+
+        /// Opens the group for the calling thread, returns \c false if perf events are not permitted.
+        bool open();
+        void close();
+
+        bool isOpen() const { return leader != -1; }
+
+        /// Whether the group counts the calling thread, identities of workers can move between threads.
+        bool isOwnedByCurrentThread() const { return owner == std::this_thread::get_id(); }
+
+        bool read(Sample& _sample) const;
+
+    private:
+        int leader;
+        int descriptors[COUNTER_COUNT];
+
+        /// Position of every counter in the group's read buffer, -1 if it could not be opened.
+        int positions[COUNTER_COUNT];
+        int openCount;
+        std::thread::id owner;
+    };
+}
@@ -0,0 +1,174 @@
+#include "Pipeline.hpp"
+#include "Task.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace orbit
+{
+    namespace
+    {
+        struct Token
+        {
+            void* item;
+            size_t sequence;
+            size_t stage;
+        };
+
+        struct StageState
+        {
+            StageState(Pipeline::StageMode _mode, Pipeline::Stage _function) : mode(_mode), function(_function), nextSequence(0) {}
+
+            Pipeline::StageMode mode;
+            Pipeline::Stage function;
+
+            // tokens which reached a serial stage before their predecessors, keyed by sequence number
+            std::mutex guard;
+            size_t nextSequence;
+            std::map<size_t, Token*> parked;
+        };
+    }
+
+    class Pipeline::Pimpl
+    {
+    public:
+        Pimpl(Scheduler& _scheduler) : scheduler(_scheduler), root(0, 0)
+        {
+            runner = [this](const TaskData& _data)
+            {
+                process(static_cast<Token*>(_data.kernelData));
+            };
+        }
+
+        void spawn(Token* _token);
+        void process(Token* _token);
+
+        Scheduler& scheduler;
+        Kernel runner;
+        TaskId root;
+
+        std::vector<std::unique_ptr<StageState>> stages;
+        std::vector<Token> tokens;
+
+        std::mutex inputGuard;
+        size_t inputSequence;
+        bool inputExhausted;
+    };
+
+    void Pipeline::Pimpl::spawn(Token* _token)
+    {
+        TaskId task = scheduler.addTask(_token, runner);
+        scheduler.addChild(root, task);
+        scheduler.runTask(task);
+    }
+
+    void Pipeline::Pimpl::process(Token* _token)
+    {
+        for (;;)
+        {
+            if (_token->stage == 0)
+            {
+                std::lock_guard<std::mutex> lock(inputGuard);
+                _token->item = inputExhausted ? nullptr : stages[0]->function(nullptr);
+                if (!_token->item)
+                {
+                    // no more input, the token retires
+                    inputExhausted = true;
+                    return;
+                }
+
+                _token->sequence = inputSequence++;
+                _token->stage = 1;
+            }
+
+            for (; _token->stage != stages.size(); ++_token->stage)
+            {
+                StageState& stage = *stages[_token->stage];
+                if (stage.mode == PARALLEL)
+                {
+                    _token->item = stage.function(_token->item);
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(stage.guard);
+                    if (_token->sequence != stage.nextSequence)
+                    {
+                        // it is not this token's turn yet, its predecessor picks it up once it is done with the stage
+                        stage.parked[_token->sequence] = _token;
+                        return;
+                    }
+                }
+
+                _token->item = stage.function(_token->item);
+
+                Token* successor = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(stage.guard);
+                    auto parked = stage.parked.find(++stage.nextSequence);
+                    if (parked != stage.parked.end())
+                    {
+                        successor = parked->second;
+                        stage.parked.erase(parked);
+                    }
+                }
+
+                if (successor)
+                {
+                    spawn(successor);
+                }
+            }
+
+            // the token made it through every stage, reuse it for the next input on this worker
+            _token->stage = 0;
+        }
+    }
+
+    Pipeline::Pipeline(Scheduler& _scheduler)
+    {
+        impl = new Pimpl(_scheduler);
+    }
+
+    Pipeline::~Pipeline()
+    {
+        delete impl;
+    }
+
+    void Pipeline::addStage(StageMode _mode, Stage _stage)
+    {
+        // the input stage always runs serially, it hands out the sequence numbers
+        const StageMode mode = impl->stages.empty() ? SERIAL_IN_ORDER : _mode;
+        impl->stages.push_back(std::unique_ptr<StageState>(new StageState(mode, _stage)));
+    }
+
+    void Pipeline::run(size_t _maxTokens)
+    {
+        if (impl->stages.empty() || _maxTokens == 0)
+        {
+            return;
+        }
+
+        for (auto& stage : impl->stages)
+        {
+            stage->nextSequence = 0;
+            stage->parked.clear();
+        }
+        impl->inputSequence = 0;
+        impl->inputExhausted = false;
+
+        const Token unused = { nullptr, 0, 0 };
+        impl->tokens.assign(_maxTokens, unused);
+
+        // every token gets its own runner, the root finishes once all of them have retired
+        impl->root = impl->scheduler.addEmptyTask();
+        for (Token& token : impl->tokens)
+        {
+            impl->spawn(&token);
+        }
+
+        impl->scheduler.runTask(impl->root);
+        impl->scheduler.wait(impl->root);
+    }
+}
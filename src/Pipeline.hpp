@@ -0,0 +1,40 @@
+#pragma once
+#include <functional>
+
+#include "TaskCore.hpp"
+
+namespace orbit
+{
+    class Scheduler;
+
+    /// Runs a stream of tokens through a sequence of stages on top of a Scheduler. A token moves on to the next stage on
+    /// the worker which finished the previous one, so its data is still in cache.
+    class Pipeline
+    {
+    public:
+        class Pimpl;
+
+        enum StageMode
+        {
+            PARALLEL,
+            SERIAL_IN_ORDER,
+        };
+
+        /// A stage receives the token of the previous stage and returns the token for the next one.
+        typedef std::function<void*(void*)> Stage;
+
+        Pipeline(Scheduler& _scheduler);
+        Pipeline(const Pipeline &) = delete;
+        ~Pipeline();
+
+        /// The first stage is the input, it is called serially with \c nullptr and returns \c nullptr once it is exhausted.
+        void addStage(StageMode _mode, Stage _stage);
+
+        /// Runs the pipeline until the input is exhausted with at most \a _maxTokens tokens in flight. The calling thread
+        /// helps with work in the meantime.
+        void run(size_t _maxTokens);
+
+    private:
+        Pimpl *impl;
+    };
+}
@@ -0,0 +1,349 @@
+#include "StreamingKernels.hpp"
+
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ORBIT_X86
+// the AVX-512 intrinsics start from deliberately undefined registers, which GCC reports once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Never fuse multiplies and adds, the AVX-512 target implies FMA while the other instruction sets have none,
+// and fusing rounds differently, so results would depend on the instruction set.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace orbit
+{
+    namespace kernels
+    {
+        namespace
+        {
+            typedef void (*KernelFunction)(const TaskData&);
+
+            struct KernelTable
+            {
+                KernelFunction addF32, subtractF32, multiplyF32, minF32, maxF32;
+                KernelFunction addI32, subtractI32, multiplyI32, minI32, maxI32;
+                KernelFunction saxpy, clampF32, clampI32, convertF32ToI32, convertI32ToF32;
+            };
+
+            struct Scalar
+            {
+                typedef float F32;
+                typedef int32_t I32;
+                static const size_t LANES = 1;
+
+                static F32 loadF32(const float* _p) { return *_p; }
+                static I32 loadI32(const int32_t* _p) { return *_p; }
+                static void storeF32(float* _p, F32 _v) { *_p = _v; }
+                static void storeI32(int32_t* _p, I32 _v) { *_p = _v; }
+                static F32 setF32(float _v) { return _v; }
+                static I32 setI32(int32_t _v) { return _v; }
+
+                // min/max follow the SSE semantics, the second operand is returned if either one is NaN
+                static F32 addF32(F32 _a, F32 _b) { return _a + _b; }
+                static F32 subtractF32(F32 _a, F32 _b) { return _a - _b; }
+                static F32 multiplyF32(F32 _a, F32 _b) { return _a * _b; }
+                static F32 minF32(F32 _a, F32 _b) { return _a < _b ? _a : _b; }
+                static F32 maxF32(F32 _a, F32 _b) { return _a > _b ? _a : _b; }
+
+                // integer arithmetic wraps around like the vector instructions do
+                static I32 addI32(I32 _a, I32 _b) { return static_cast<I32>(static_cast<uint32_t>(_a) + static_cast<uint32_t>(_b)); }
+                static I32 subtractI32(I32 _a, I32 _b) { return static_cast<I32>(static_cast<uint32_t>(_a) - static_cast<uint32_t>(_b)); }
+                static I32 multiplyI32(I32 _a, I32 _b) { return static_cast<I32>(static_cast<uint32_t>(_a) * static_cast<uint32_t>(_b)); }
+                static I32 minI32(I32 _a, I32 _b) { return _a < _b ? _a : _b; }
+                static I32 maxI32(I32 _a, I32 _b) { return _a > _b ? _a : _b; }
+
+                static I32 convertF32ToI32(F32 _v) { return static_cast<I32>(_v); }
+                static F32 convertI32ToF32(I32 _v) { return static_cast<F32>(_v); }
+            };
+
+            namespace scalar
+            {
+                typedef Scalar Vector;
+#include "StreamingKernels.inl"
+            }
+
+#ifdef ORBIT_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+            namespace sse2
+            {
+                struct Vector
+                {
+                    typedef __m128 F32;
+                    typedef __m128i I32;
+                    static const size_t LANES = 4;
+
+                    static F32 loadF32(const float* _p) { return _mm_loadu_ps(_p); }
+                    static I32 loadI32(const int32_t* _p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(_p)); }
+                    static void storeF32(float* _p, F32 _v) { _mm_storeu_ps(_p, _v); }
+                    static void storeI32(int32_t* _p, I32 _v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(_p), _v); }
+                    static F32 setF32(float _v) { return _mm_set1_ps(_v); }
+                    static I32 setI32(int32_t _v) { return _mm_set1_epi32(_v); }
+
+                    static F32 addF32(F32 _a, F32 _b) { return _mm_add_ps(_a, _b); }
+                    static F32 subtractF32(F32 _a, F32 _b) { return _mm_sub_ps(_a, _b); }
+                    static F32 multiplyF32(F32 _a, F32 _b) { return _mm_mul_ps(_a, _b); }
+                    static F32 minF32(F32 _a, F32 _b) { return _mm_min_ps(_a, _b); }
+                    static F32 maxF32(F32 _a, F32 _b) { return _mm_max_ps(_a, _b); }
+
+                    static I32 addI32(I32 _a, I32 _b) { return _mm_add_epi32(_a, _b); }
+                    static I32 subtractI32(I32 _a, I32 _b) { return _mm_sub_epi32(_a, _b); }
+
+                    static I32 multiplyI32(I32 _a, I32 _b)
+                    {
+                        // SSE2 has no 32 bit multiply, multiply even and odd lanes separately and interleave the low halves
+                        const __m128i even = _mm_mul_epu32(_a, _b);
+                        const __m128i odd = _mm_mul_epu32(_mm_srli_si128(_a, 4), _mm_srli_si128(_b, 4));
+                        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+                    }
+
+                    static I32 minI32(I32 _a, I32 _b)
+                    {
+                        const __m128i less = _mm_cmplt_epi32(_a, _b);
+                        return _mm_or_si128(_mm_and_si128(less, _a), _mm_andnot_si128(less, _b));
+                    }
+
+                    static I32 maxI32(I32 _a, I32 _b)
+                    {
+                        const __m128i greater = _mm_cmpgt_epi32(_a, _b);
+                        return _mm_or_si128(_mm_and_si128(greater, _a), _mm_andnot_si128(greater, _b));
+                    }
+
+                    static I32 convertF32ToI32(F32 _v) { return _mm_cvttps_epi32(_v); }
+                    static F32 convertI32ToF32(I32 _v) { return _mm_cvtepi32_ps(_v); }
+                };
+#include "StreamingKernels.inl"
+            }
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+            namespace avx2
+            {
+                struct Vector
+                {
+                    typedef __m256 F32;
+                    typedef __m256i I32;
+                    static const size_t LANES = 8;
+
+                    static F32 loadF32(const float* _p) { return _mm256_loadu_ps(_p); }
+                    static I32 loadI32(const int32_t* _p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_p)); }
+                    static void storeF32(float* _p, F32 _v) { _mm256_storeu_ps(_p, _v); }
+                    static void storeI32(int32_t* _p, I32 _v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(_p), _v); }
+                    static F32 setF32(float _v) { return _mm256_set1_ps(_v); }
+                    static I32 setI32(int32_t _v) { return _mm256_set1_epi32(_v); }
+
+                    static F32 addF32(F32 _a, F32 _b) { return _mm256_add_ps(_a, _b); }
+                    static F32 subtractF32(F32 _a, F32 _b) { return _mm256_sub_ps(_a, _b); }
+                    static F32 multiplyF32(F32 _a, F32 _b) { return _mm256_mul_ps(_a, _b); }
+                    static F32 minF32(F32 _a, F32 _b) { return _mm256_min_ps(_a, _b); }
+                    static F32 maxF32(F32 _a, F32 _b) { return _mm256_max_ps(_a, _b); }
+
+                    static I32 addI32(I32 _a, I32 _b) { return _mm256_add_epi32(_a, _b); }
+                    static I32 subtractI32(I32 _a, I32 _b) { return _mm256_sub_epi32(_a, _b); }
+                    static I32 multiplyI32(I32 _a, I32 _b) { return _mm256_mullo_epi32(_a, _b); }
+                    static I32 minI32(I32 _a, I32 _b) { return _mm256_min_epi32(_a, _b); }
+                    static I32 maxI32(I32 _a, I32 _b) { return _mm256_max_epi32(_a, _b); }
+
+                    static I32 convertF32ToI32(F32 _v) { return _mm256_cvttps_epi32(_v); }
+                    static F32 convertI32ToF32(I32 _v) { return _mm256_cvtepi32_ps(_v); }
+                };
+#include "StreamingKernels.inl"
+            }
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+            namespace avx512
+            {
+                struct Vector
+                {
+                    typedef __m512 F32;
+                    typedef __m512i I32;
+                    static const size_t LANES = 16;
+
+                    static F32 loadF32(const float* _p) { return _mm512_loadu_ps(_p); }
+                    static I32 loadI32(const int32_t* _p) { return _mm512_loadu_si512(_p); }
+                    static void storeF32(float* _p, F32 _v) { _mm512_storeu_ps(_p, _v); }
+                    static void storeI32(int32_t* _p, I32 _v) { _mm512_storeu_si512(_p, _v); }
+                    static F32 setF32(float _v) { return _mm512_set1_ps(_v); }
+                    static I32 setI32(int32_t _v) { return _mm512_set1_epi32(_v); }
+
+                    static F32 addF32(F32 _a, F32 _b) { return _mm512_add_ps(_a, _b); }
+                    static F32 subtractF32(F32 _a, F32 _b) { return _mm512_sub_ps(_a, _b); }
+                    static F32 multiplyF32(F32 _a, F32 _b) { return _mm512_mul_ps(_a, _b); }
+                    static F32 minF32(F32 _a, F32 _b) { return _mm512_min_ps(_a, _b); }
+                    static F32 maxF32(F32 _a, F32 _b) { return _mm512_max_ps(_a, _b); }
+
+                    static I32 addI32(I32 _a, I32 _b) { return _mm512_add_epi32(_a, _b); }
+                    static I32 subtractI32(I32 _a, I32 _b) { return _mm512_sub_epi32(_a, _b); }
+                    static I32 multiplyI32(I32 _a, I32 _b) { return _mm512_mullo_epi32(_a, _b); }
+                    static I32 minI32(I32 _a, I32 _b) { return _mm512_min_epi32(_a, _b); }
+                    static I32 maxI32(I32 _a, I32 _b) { return _mm512_max_epi32(_a, _b); }
+
+                    static I32 convertF32ToI32(F32 _v) { return _mm512_cvttps_epi32(_v); }
+                    static F32 convertI32ToF32(I32 _v) { return _mm512_cvtepi32_ps(_v); }
+                };
+#include "StreamingKernels.inl"
+            }
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+            void cpuid(int _leaf, unsigned int _registers[4])
+            {
+#if defined(_MSC_VER)
+                __cpuidex(reinterpret_cast<int*>(_registers), _leaf, 0);
+#else
+                if (!__get_cpuid_count(_leaf, 0, &_registers[0], &_registers[1], &_registers[2], &_registers[3]))
+                {
+                    _registers[0] = _registers[1] = _registers[2] = _registers[3] = 0;
+                }
+#endif
+            }
+
+            uint64_t enabledStateComponents()
+            {
+#if defined(_MSC_VER)
+                return _xgetbv(0);
+#else
+                unsigned int eax, edx;
+                __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+            }
+#endif
+
+            const KernelTable* tables[] =
+            {
+                &scalar::table,
+#ifdef ORBIT_X86
+                &sse2::table,
+                &avx2::table,
+                &avx512::table,
+#endif
+            };
+
+            InstructionSet instructionSet = SCALAR;
+            const KernelTable* active = &scalar::table;
+        }
+
+        InstructionSet detectInstructionSet()
+        {
+#ifdef ORBIT_X86
+            unsigned int leaf1[4];
+            unsigned int leaf7[4] = {};
+            cpuid(0, leaf1);
+            const unsigned int maximumLeaf = leaf1[0];
+            cpuid(1, leaf1);
+            if (maximumLeaf >= 7)
+            {
+                cpuid(7, leaf7);
+            }
+
+            const bool sse2 = (leaf1[3] & (1u << 26)) != 0;
+            const bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+            const bool avx = (leaf1[2] & (1u << 28)) != 0;
+            const bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+            const bool avx512f = (leaf7[1] & (1u << 16)) != 0;
+
+            // the operating system has to save the vector registers on context switches, check XCR0 for that
+            const uint64_t xcr0 = (osxsave && avx) ? enabledStateComponents() : 0;
+            const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+            const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+            if (avx512f && zmmEnabled)
+            {
+                return AVX512;
+            }
+            if (avx2 && ymmEnabled)
+            {
+                return AVX2;
+            }
+            if (sse2)
+            {
+                return SSE2;
+            }
+#endif
+            return SCALAR;
+        }
+
+        void initialise()
+        {
+            selectInstructionSet(AVX512);
+        }
+
+        void selectInstructionSet(InstructionSet _instructionSet)
+        {
+            const InstructionSet supported = detectInstructionSet();
+            instructionSet = _instructionSet < supported ? _instructionSet : supported;
+            active = tables[instructionSet];
+        }
+
+        InstructionSet activeInstructionSet()
+        {
+            return instructionSet;
+        }
+
+        void addF32(const TaskData& _data) { active->addF32(_data); }
+        void subtractF32(const TaskData& _data) { active->subtractF32(_data); }
+        void multiplyF32(const TaskData& _data) { active->multiplyF32(_data); }
+        void minF32(const TaskData& _data) { active->minF32(_data); }
+        void maxF32(const TaskData& _data) { active->maxF32(_data); }
+
+        void addI32(const TaskData& _data) { active->addI32(_data); }
+        void subtractI32(const TaskData& _data) { active->subtractI32(_data); }
+        void multiplyI32(const TaskData& _data) { active->multiplyI32(_data); }
+        void minI32(const TaskData& _data) { active->minI32(_data); }
+        void maxI32(const TaskData& _data) { active->maxI32(_data); }
+
+        void saxpy(const TaskData& _data) { active->saxpy(_data); }
+        void clampF32(const TaskData& _data) { active->clampF32(_data); }
+        void clampI32(const TaskData& _data) { active->clampI32(_data); }
+        void convertF32ToI32(const TaskData& _data) { active->convertF32ToI32(_data); }
+        void convertI32ToF32(const TaskData& _data) { active->convertI32ToF32(_data); }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+#include "TaskCore.hpp"
+
+namespace orbit
+{
+    /// Ready-made streaming kernels for addStreamingTask. Streams have to be tightly packed arrays of the element type,
+    /// binary operations read inputStreams[0] and inputStreams[1] and write outputStreams[0].
+    namespace kernels
+    {
+        enum InstructionSet
+        {
+            SCALAR,
+            SSE2,
+            AVX2,
+            AVX512,
+        };
+
+        /// Selects the best implementation the CPU supports, called by Scheduler::initialise.
+        void initialise();
+
+        /// Forces a specific implementation, falls back to the best supported one below it.
+        void selectInstructionSet(InstructionSet _instructionSet);
+
+        InstructionSet detectInstructionSet();
+        InstructionSet activeInstructionSet();
+
+        struct SaxpyParameters
+        {
+            float a;
+        };
+
+        struct ClampF32Parameters
+        {
+            float minimum;
+            float maximum;
+        };
+
+        struct ClampI32Parameters
+        {
+            int32_t minimum;
+            int32_t maximum;
+        };
+
+        void addF32(const TaskData& _data);
+        void subtractF32(const TaskData& _data);
+        void multiplyF32(const TaskData& _data);
+        void minF32(const TaskData& _data);
+        void maxF32(const TaskData& _data);
+
+        void addI32(const TaskData& _data);
+        void subtractI32(const TaskData& _data);
+        void multiplyI32(const TaskData& _data);
+        void minI32(const TaskData& _data);
+        void maxI32(const TaskData& _data);
+
+        /// outputStreams[0] = a * inputStreams[0] + inputStreams[1], kernelData points to SaxpyParameters.
+        void saxpy(const TaskData& _data);
+
+        /// Clamps inputStreams[0] into outputStreams[0], kernelData points to ClampF32Parameters/ClampI32Parameters.
+        void clampF32(const TaskData& _data);
+        void clampI32(const TaskData& _data);
+
+        /// Converts inputStreams[0] into outputStreams[0], floats are truncated and have to be in range.
+        void convertF32ToI32(const TaskData& _data);
+        void convertI32ToF32(const TaskData& _data);
+    }
+}
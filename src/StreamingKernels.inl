@@ -0,0 +1,182 @@
+// Kernel loops shared by all instruction sets, included into a namespace which defines the Vector traits.
+// The including file selects the target instruction set, so everything in here is compiled for it.
+
+struct Add
+{
+    template <typename T> static typename T::F32 f32(typename T::F32 _a, typename T::F32 _b) { return T::addF32(_a, _b); }
+    template <typename T> static typename T::I32 i32(typename T::I32 _a, typename T::I32 _b) { return T::addI32(_a, _b); }
+};
+
+struct Subtract
+{
+    template <typename T> static typename T::F32 f32(typename T::F32 _a, typename T::F32 _b) { return T::subtractF32(_a, _b); }
+    template <typename T> static typename T::I32 i32(typename T::I32 _a, typename T::I32 _b) { return T::subtractI32(_a, _b); }
+};
+
+struct Multiply
+{
+    template <typename T> static typename T::F32 f32(typename T::F32 _a, typename T::F32 _b) { return T::multiplyF32(_a, _b); }
+    template <typename T> static typename T::I32 i32(typename T::I32 _a, typename T::I32 _b) { return T::multiplyI32(_a, _b); }
+};
+
+struct Min
+{
+    template <typename T> static typename T::F32 f32(typename T::F32 _a, typename T::F32 _b) { return T::minF32(_a, _b); }
+    template <typename T> static typename T::I32 i32(typename T::I32 _a, typename T::I32 _b) { return T::minI32(_a, _b); }
+};
+
+struct Max
+{
+    template <typename T> static typename T::F32 f32(typename T::F32 _a, typename T::F32 _b) { return T::maxF32(_a, _b); }
+    template <typename T> static typename T::I32 i32(typename T::I32 _a, typename T::I32 _b) { return T::maxI32(_a, _b); }
+};
+
+template <typename Op>
+struct BinaryF32
+{
+    const float* a;
+    const float* b;
+    float* out;
+
+    explicit BinaryF32(const TaskData& _data)
+        : a(static_cast<const float*>(_data.specificData.streamingData.inputStreams[0]))
+        , b(static_cast<const float*>(_data.specificData.streamingData.inputStreams[1]))
+        , out(static_cast<float*>(_data.specificData.streamingData.outputStreams[0]))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeF32(out + _i, Op::template f32<T>(T::loadF32(a + _i), T::loadF32(b + _i))); }
+};
+
+template <typename Op>
+struct BinaryI32
+{
+    const int32_t* a;
+    const int32_t* b;
+    int32_t* out;
+
+    explicit BinaryI32(const TaskData& _data)
+        : a(static_cast<const int32_t*>(_data.specificData.streamingData.inputStreams[0]))
+        , b(static_cast<const int32_t*>(_data.specificData.streamingData.inputStreams[1]))
+        , out(static_cast<int32_t*>(_data.specificData.streamingData.outputStreams[0]))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeI32(out + _i, Op::template i32<T>(T::loadI32(a + _i), T::loadI32(b + _i))); }
+};
+
+struct Saxpy
+{
+    const float* x;
+    const float* y;
+    float* out;
+    float a;
+
+    explicit Saxpy(const TaskData& _data)
+        : x(static_cast<const float*>(_data.specificData.streamingData.inputStreams[0]))
+        , y(static_cast<const float*>(_data.specificData.streamingData.inputStreams[1]))
+        , out(static_cast<float*>(_data.specificData.streamingData.outputStreams[0]))
+        , a(static_cast<const SaxpyParameters*>(_data.kernelData)->a)
+    {
+    }
+
+    // multiply and add separately rather than fused, so all instruction sets produce identical results
+    template <typename T> void step(size_t _i) const { T::storeF32(out + _i, T::addF32(T::multiplyF32(T::setF32(a), T::loadF32(x + _i)), T::loadF32(y + _i))); }
+};
+
+struct ClampF32
+{
+    const float* in;
+    float* out;
+    ClampF32Parameters parameters;
+
+    explicit ClampF32(const TaskData& _data)
+        : in(static_cast<const float*>(_data.specificData.streamingData.inputStreams[0]))
+        , out(static_cast<float*>(_data.specificData.streamingData.outputStreams[0]))
+        , parameters(*static_cast<const ClampF32Parameters*>(_data.kernelData))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeF32(out + _i, T::minF32(T::maxF32(T::loadF32(in + _i), T::setF32(parameters.minimum)), T::setF32(parameters.maximum))); }
+};
+
+struct ClampI32
+{
+    const int32_t* in;
+    int32_t* out;
+    ClampI32Parameters parameters;
+
+    explicit ClampI32(const TaskData& _data)
+        : in(static_cast<const int32_t*>(_data.specificData.streamingData.inputStreams[0]))
+        , out(static_cast<int32_t*>(_data.specificData.streamingData.outputStreams[0]))
+        , parameters(*static_cast<const ClampI32Parameters*>(_data.kernelData))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeI32(out + _i, T::minI32(T::maxI32(T::loadI32(in + _i), T::setI32(parameters.minimum)), T::setI32(parameters.maximum))); }
+};
+
+struct ConvertF32ToI32
+{
+    const float* in;
+    int32_t* out;
+
+    explicit ConvertF32ToI32(const TaskData& _data)
+        : in(static_cast<const float*>(_data.specificData.streamingData.inputStreams[0]))
+        , out(static_cast<int32_t*>(_data.specificData.streamingData.outputStreams[0]))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeI32(out + _i, T::convertF32ToI32(T::loadF32(in + _i))); }
+};
+
+struct ConvertI32ToF32
+{
+    const int32_t* in;
+    float* out;
+
+    explicit ConvertI32ToF32(const TaskData& _data)
+        : in(static_cast<const int32_t*>(_data.specificData.streamingData.inputStreams[0]))
+        , out(static_cast<float*>(_data.specificData.streamingData.outputStreams[0]))
+    {
+    }
+
+    template <typename T> void step(size_t _i) const { T::storeF32(out + _i, T::convertI32ToF32(T::loadI32(in + _i))); }
+};
+
+// Vector loop over the whole lanes, returns where the scalar tail starts. The scalar build has a single lane
+// and only runs the tail loop, so the vector loop is not instantiated for it at all.
+template <typename Kernel>
+size_t streamVector(const Kernel& _kernel, size_t _elementCount, std::true_type)
+{
+    size_t i = 0;
+    for (; i + Vector::LANES <= _elementCount; i += Vector::LANES)
+    {
+        _kernel.template step<Vector>(i);
+    }
+    return i;
+}
+
+template <typename Kernel>
+size_t streamVector(const Kernel&, size_t, std::false_type)
+{
+    return 0;
+}
+
+template <typename Kernel>
+void stream(const TaskData& _data)
+{
+    const Kernel kernel(_data);
+    const size_t elementCount = _data.specificData.streamingData.elementCount;
+    for (size_t i = streamVector(kernel, elementCount, std::integral_constant<bool, (Vector::LANES > 1)>()); i != elementCount; ++i)
+    {
+        kernel.template step<Scalar>(i);
+    }
+}
+
+const KernelTable table =
+{
+    &stream<BinaryF32<Add> >, &stream<BinaryF32<Subtract> >, &stream<BinaryF32<Multiply> >, &stream<BinaryF32<Min> >, &stream<BinaryF32<Max> >,
+    &stream<BinaryI32<Add> >, &stream<BinaryI32<Subtract> >, &stream<BinaryI32<Multiply> >, &stream<BinaryI32<Min> >, &stream<BinaryI32<Max> >,
+    &stream<Saxpy>, &stream<ClampF32>, &stream<ClampI32>, &stream<ConvertF32ToI32>, &stream<ConvertI32ToF32>,
+};
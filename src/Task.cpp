@@ -1,4 +1,15 @@
 #include "Task.hpp"
+#include "TimerWheel.hpp"
+#include "StreamingKernels.hpp"
+#include "MappedFile.hpp"
+#include "AsyncIo.hpp"
+#include "CpuQuota.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
 
 namespace orbit
 {
@@ -7,6 +18,46 @@ namespace orbit
 #else
         __thread ThreadType threadType;
 #endif
+
+    namespace
+    {
+        // whether the identity of this thread was handed out by attachCurrentThread rather than the pool
+#ifdef _WIN32
+        __declspec(thread) bool attachedThread;
+#else
+        __thread bool attachedThread;
+#endif
+
+        /// State of a thread without a worker identity, such as the main thread or an application thread which waits on tasks
+        /// or runs them inline. Those threads would otherwise all share the state of identity zero.
+        struct ExternalThreadState
+        {
+            ExternalThreadState() : scheduler(0), scratchEpoch(0) {}
+
+            /// Scheduler the state belongs to, it is set up again when the thread moves on to another one.
+            uint64_t scheduler;
+            uint64_t scratchEpoch;
+            std::unique_ptr<LinearArena> scratch;
+            std::unique_ptr<PerfCounters> counters;
+        };
+        thread_local ExternalThreadState externalThread;
+
+        ExternalThreadState& externalThreadOf(uint64_t _scheduler)
+        {
+            ExternalThreadState& state = externalThread;
+            if (state.scheduler != _scheduler)
+            {
+                state.scheduler = _scheduler;
+                state.scratchEpoch = 0;
+                state.scratch.reset(new LinearArena(configuration::SCRATCH_ARENA_SIZE));
+                state.counters.reset(new PerfCounters());
+            }
+            return state;
+        }
+
+        std::atomic<uint64_t> schedulerCount(0);
+    }
+
     const char* ThreadName()
     {
         switch (threadType)
@@ -24,84 +75,281 @@ namespace orbit
         }
     }
 
-    ThreadPool::ThreadPool(Scheduler &_scheduler, TaskQueue &_queue) : scheduler(_scheduler), queue(_queue)
+    ThreadPool::ThreadPool(Scheduler &_scheduler, TaskQueue &_queue) : scheduler(_scheduler), queue(_queue),
+        minimumThreads(0), maximumThreads(0), idleTimeout(0)
     {
-        threadNumber = 0;
+        identities = 0;
+        busyThreads = 0;
+        runningThreads = 0;
+        backedUpSince = 0;
+        for (auto& state : slotStates)
+        {
+            state = EMPTY;
+        }
         shouldRun.store(true);
     }
 
     void ThreadPool::initialise(uint8_t _numberOfThreads)
     {
-        threads.reserve(_numberOfThreads);
-        auto work = std::bind(&ThreadPool::initialiseThread, this);
-        for (uint8_t i(0); i != _numberOfThreads; ++i)
+        initialise(_numberOfThreads, _numberOfThreads, std::chrono::milliseconds(0));
+    }
+
+    void ThreadPool::initialise(uint8_t _minimum, uint8_t _maximum, std::chrono::milliseconds _idleTimeout)
+    {
+        maximumThreads = _maximum < configuration::MAX_WORKER_THREAD_COUNT ? _maximum : configuration::MAX_WORKER_THREAD_COUNT;
+        minimumThreads = _minimum < maximumThreads ? _minimum : maximumThreads;
+        idleTimeout = _idleTimeout;
+
+        std::lock_guard<std::mutex> lock(slotGuard);
+        for (int i(0); i != minimumThreads; ++i)
+        {
+            if (!startThread(i))
+            {
+                break;
+            }
+        }
+    }
+
+    bool ThreadPool::startThread(unsigned int _slot)
+    {
+        // the identity is claimed up front, a thread without one would work as MAIN and share its scratch arena
+        const int number = acquireIdentity();
+        if (number < 0)
+        {
+            return false;
+        }
+
+        if (threads[_slot].joinable())
         {
-            threads.push_back(std::thread(work));
+            // the previous occupant has retired and is on its way out
+            threads[_slot].join();
         }
+
+        ++runningThreads;
+        slotStates[_slot] = RUNNING;
+        threads[_slot] = std::thread(&ThreadPool::initialiseThread, this, _slot, number);
+        return true;
+    }
+
+    void ThreadPool::initialiseThread(unsigned int _slot, int _number)
+    {
+        ::orbit::threadType = static_cast<ThreadType>(ThreadType::TASK0 + _number);
+
+        work(_slot);
+
+        releaseIdentity(_number);
     }
 
-    void ThreadPool::initialiseThread()
+    int ThreadPool::acquireIdentity()
     {
-        int number = threadNumber++;
-        ::orbit::threadType = static_cast<ThreadType>(ThreadType::TASK0 + number);
+        uint32_t taken = identities.load();
+        for (;;)
+        {
+            // claim the lowest free bit, pool threads and attached threads share the same identities
+            unsigned int number = 0;
+            while (number != configuration::MAX_WORKER_THREAD_COUNT && (taken & (1u << number)))
+            {
+                ++number;
+            }
+            if (number == configuration::MAX_WORKER_THREAD_COUNT)
+            {
+                return -1;
+            }
+            if (identities.compare_exchange_weak(taken, taken | (1u << number)))
+            {
+                return static_cast<int>(number);
+            }
+        }
+    }
 
-        work();
+    void ThreadPool::releaseIdentity(int _number)
+    {
+        identities.fetch_and(~(1u << _number));
     }
-    void ThreadPool::work()
+    void ThreadPool::work(unsigned int _slot)
     {
+        auto idleSince = std::chrono::steady_clock::now();
         while (shouldRun.load())
         {
-            Task* task = queue.waitUntilTaskIsAvailable();
+            Task* task = queue.getAvailableTask();
             if (task)
             {
+                // a steady backlog never lets a worker go idle, so due timers and I/O completions are checked between tasks
+                scheduler.serviceIfDue();
+            }
+            else
+            {
+                // idle workers service timers and I/O completions before they park
+                int timeout = scheduler.serviceIdle();
+                if (runningThreads.load(std::memory_order_relaxed) > minimumThreads && timeout > idleTimeout.count())
+                {
+                    // wake up in time to retire
+                    timeout = static_cast<int>(idleTimeout.count());
+                }
+                task = queue.waitUntilTaskIsAvailable(timeout);
+            }
+
+            if (task)
+            {
+                // a backlog the producer only waits on is noticed here, whoever queued it may never come back to check
+                growIfBackedUp();
+
+                ++busyThreads;
                 scheduler.workOnTask(task);
+                --busyThreads;
+                idleSince = std::chrono::steady_clock::now();
+            }
+            else if (std::chrono::steady_clock::now() - idleSince >= idleTimeout && retire(_slot))
+            {
+                return;
             }
         }
     }
 
-    void ThreadPool::shutdown()
+    bool ThreadPool::retire(unsigned int _slot)
     {
-        shouldRun.store(false);
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-
-        for (auto &thread : threads)
+        int running = runningThreads.load();
+        do
         {
-            if (thread.joinable())
+            if (running <= minimumThreads)
             {
-                thread.join();
+                return false;
             }
-        }
+        } while (!runningThreads.compare_exchange_weak(running, running - 1));
+
+        slotStates[_slot] = RETIRED;
+        return true;
     }
 
-    void TaskQueue::queueTask(Task* task)
+    void ThreadPool::growIfBackedUp()
     {
-        queue.push(task);
+        const int running = runningThreads.load(std::memory_order_relaxed);
+        if (running >= maximumThreads)
+        {
+            return;
+        }
+
+        if (queue.size() <= static_cast<size_t>(running))
+        {
+            backedUpSince.store(0, std::memory_order_relaxed);
+            return;
+        }
+
+        // a short burst is absorbed by the running threads, only a backlog that persists earns another thread
+        const int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t since = backedUpSince.load(std::memory_order_relaxed);
+        if (since == 0)
+        {
+            backedUpSince.compare_exchange_strong(since, now);
+            return;
+        }
+        if (now - since < configuration::WORKER_GROWTH_DELAY_US)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(slotGuard, std::try_to_lock);
+        if (!lock.owns_lock() || !shouldRun.load() || runningThreads.load() >= maximumThreads)
+        {
+            return;
+        }
+
+        for (unsigned int slot(0); slot != configuration::MAX_WORKER_THREAD_COUNT; ++slot)
+        {
+            if (slotStates[slot] != RUNNING)
+            {
+                startThread(slot);
+                break;
+            }
+        }
+        backedUpSince.store(0, std::memory_order_relaxed);
     }
 
-    Task* TaskQueue::waitUntilTaskIsAvailable()
+    bool ThreadPool::allThreadsBusy() const
     {
-        Task* task;
-        return queue.tryWaitAndPop(task, 1000) ? task : nullptr;
+        return busyThreads.load(std::memory_order_relaxed) >= runningThreads.load(std::memory_order_relaxed);
     }
 
-    Task* TaskQueue::getAvailableTask()
+    void ThreadPool::shutdown()
     {
-        Task* task;
-        return queue.tryPop(task) ? task : nullptr;
-    }
+        shouldRun.store(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
+        std::lock_guard<std::mutex> lock(slotGuard);
+        for (auto &thread : threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
 
     class Scheduler::Pimpl
     {
     public:
-        Pimpl(Scheduler &_scheduler) : threads(_scheduler, queue)
+        Pimpl(Scheduler &_scheduler) : taskPool(core.getTaskPool()), queue(core.getQueue()), threads(_scheduler, queue),
+            instance(++schedulerCount), epoch(std::chrono::steady_clock::now()),
+            scratchReset(PER_TASK), frameArena(configuration::FRAME_ARENA_SIZE), schedulingPolicy(FIFO), inlineCutoff(0), elastic(false)
         {
+            inlinedTaskCount = 0;
+            servicedTick = 0;
+            scratchEpoch = 0;
+            externalScratchHighWater = 0;
+            perfCountersEnabled = false;
+
+            // one scratch arena and counter group for every worker identity, threads without one bring their own
+            for (unsigned int i = 0; i != configuration::MAX_WORKER_THREAD_COUNT; ++i)
+            {
+                scratchArenas.push_back(std::unique_ptr<LinearArena>(new LinearArena(configuration::SCRATCH_ARENA_SIZE)));
+                perfCounters.push_back(std::unique_ptr<PerfCounters>(new PerfCounters()));
+            }
+        }
+
+        uint64_t currentTick() const
+        {
+            // the timer wheel ticks once per millisecond
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count();
         }
 
+        // the task pool, the queue and how tasks run and finish are shared with BasicScheduler
+        BasicScheduler<DefaultSchedulerPolicy> core;
+        TaskPool& taskPool;
+        TaskQueue& queue;
         ThreadPool threads;
-        TaskPool taskPool;
-        TaskQueue queue;
         Kernel emptyKernal;
+        const uint64_t instance;
+
+        std::chrono::steady_clock::time_point epoch;
+        std::mutex timerGuard;
+        TimerWheel timers;
+        TimerTable timerTable;
+        std::vector<TimerWheel::Timer> expiredTimers;
+        std::vector<Task*> dueTasks;
+        std::atomic<uint64_t> servicedTick;
+
+        ScratchReset scratchReset;
+        std::vector<std::unique_ptr<LinearArena>> scratchArenas;
+
+        // the arenas of threads without a worker identity reset themselves once they see a newer epoch
+        std::atomic<uint64_t> scratchEpoch;
+        std::atomic<size_t> externalScratchHighWater;
+        FrameArena frameArena;
+
+        AsyncIo io;
+
+        SchedulingPolicy schedulingPolicy;
+        DurationHistory durations;
+
+        size_t inlineCutoff;
+        std::atomic<size_t> inlinedTaskCount;
+
+        bool elastic;
+
+        std::atomic<bool> perfCountersEnabled;
+        std::vector<std::unique_ptr<PerfCounters>> perfCounters;
+        std::mutex kernelCountersGuard;
+        std::unordered_map<uint64_t, KernelCounters> kernelCounters;
     };
 
     Scheduler::Scheduler()
@@ -114,340 +362,1181 @@ namespace orbit
     }
 
     void Scheduler::initialise(uint8_t _cores)
+    {
+        initialise(_cores, _cores, std::chrono::milliseconds(0));
+    }
+
+    void Scheduler::initialise(uint8_t _minimumCores, uint8_t _maximumCores, std::chrono::milliseconds _idleTimeout)
     {
         threadType = MAIN;
-        impl->threads.initialise(_cores);
+        kernels::initialise();
+
+        // never run more workers than the cgroup quota pays for
+        const unsigned int quota = detectCpuQuota();
+        unsigned int maximum = _maximumCores < configuration::MAX_WORKER_THREAD_COUNT ? _maximumCores : configuration::MAX_WORKER_THREAD_COUNT;
+        maximum = quota && quota < maximum ? quota : maximum;
+        const unsigned int minimum = _minimumCores < maximum ? _minimumCores : maximum;
+
+        impl->elastic = minimum != maximum;
+        impl->threads.initialise(static_cast<uint8_t>(minimum), static_cast<uint8_t>(maximum), _idleTimeout);
     }
 
-    TaskId Scheduler::addTask(void *_kernelData, Kernel _kernel)
+    int Scheduler::getWorkerCount() const
     {
-        Task* task = impl->taskPool.obtainTask();
-        task->kernel = _kernel;
-        task->taskData.kernelData = _kernelData;
+        return impl->threads.getThreadCount();
+    }
 
-        return TaskId(impl->taskPool.getTaskOffset(task), task->generation);
+    TaskId Scheduler::addTask(void *_kernelData, Kernel _kernel)
+    {
+        return impl->core.addTask(_kernelData, _kernel);
     }
 
     TaskId Scheduler::addAndRunTask(void *_kernelData, Kernel _kernel)
     {
+        if (shouldRunInline())
+        {
+            // the queue is backed up anyway, running the kernel right here saves the pool slot and the queue round trip
+            Task task;
+            task.kernel = _kernel;
+            task.taskData.kernelData = _kernelData;
+            runKernel(&task);
+
+            ++impl->inlinedTaskCount;
+            return TaskId(Task::INLINED, 0);
+        }
+
         Task* task = impl->taskPool.obtainTask();
         task->kernel = _kernel;
         task->taskData.kernelData = _kernelData;
 
-        impl->queue.queueTask(task);
+        // the task may be finished and recycled as soon as it is queued, so take its id first
+        const TaskId id = impl->taskPool.getTaskId(task);
+        queueTask(task);
 
-        return TaskId(impl->taskPool.getTaskOffset(task), task->generation);
+        return id;
     }
 
-    TaskId Scheduler::addEmptyTask()
+    bool Scheduler::shouldRunInline() const
     {
-        Task* root = impl->taskPool.obtainTask();
-        root->kernel = impl->emptyKernal;
-
-        return TaskId(impl->taskPool.getTaskOffset(root), root->generation);
+        if (impl->inlineCutoff == 0)
+        {
+            return false;
+        }
+        return impl->queue.size() >= impl->inlineCutoff || impl->threads.allThreadsBusy();
     }
 
-    TaskId Scheduler::addStreamingTask(Kernel _kernel, void *_kernelData,
-        InputStream _is0, OutputStream _os0,
-        size_t _elementCount, size_t _elementsPerTask)
+    void Scheduler::setInlineCutoff(size_t _queueDepth)
     {
-        const size_t N = determineNumberOfTasks(_elementCount, _elementsPerTask);
-
-        // add a root task used for synchronisation
-        Task* root = impl->taskPool.obtainTask();
-        root->kernel = impl->emptyKernal;
-        root->openTasks = (_elementCount % N == 0) ? N + 1 : N + 2;
-        root->parent = Task::NO_PARENT;
-
-        TaskId::Offset rootOffset = impl->taskPool.getTaskOffset(root);
-        {
-            // split the task into several subtasks, according to the size of the input/output streams
-            const size_t perElementCount = _elementCount / N;
-            for (int i = 0; i < N; ++i)
-            {
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = perElementCount;
-
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + i*_is0.elementStride*perElementCount;
+        impl->inlineCutoff = _queueDepth;
+    }
 
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + i*_os0.elementStride*perElementCount;
+    size_t Scheduler::getInlinedTaskCount() const
+    {
+        return impl->inlinedTaskCount.load(std::memory_order_relaxed);
+    }
 
-                impl->queue.queueTask(task);
-            }
+    TaskId Scheduler::addEmptyTask()
+    {
+        return impl->core.addEmptyTask();
+    }
 
-            if (_elementCount % N != 0)
-            {
-                const size_t handled = perElementCount * N;
+    TaskId Scheduler::addDelayedTask(std::chrono::milliseconds _delay, void *_kernelData, Kernel _kernel)
+    {
+        return addTimer(_delay.count(), 0, _kernelData, _kernel);
+    }
 
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = _elementCount - handled;
+    TaskId Scheduler::addPeriodicTask(std::chrono::milliseconds _interval, void *_kernelData, Kernel _kernel)
+    {
+        // the timer itself never runs, it holds the kernel and releases a task for every period
+        const uint64_t interval = _interval.count() > 0 ? _interval.count() : 1;
+        return addTimer(interval, interval, _kernelData, _kernel);
+    }
 
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + N*_is0.elementStride*perElementCount;
+    TaskId Scheduler::addTimer(uint64_t _delay, uint64_t _interval, void *_kernelData, Kernel _kernel)
+    {
+        PendingTimer& pending = impl->timerTable.obtain();
+        pending.kernel = _kernel;
+        pending.kernelData = _kernelData;
 
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + N*_os0.elementStride*perElementCount;
+        // a short delay may fire and finish before schedule returns, so take the id first
+        const TaskId id(Task::FIRST_TIMER + pending.index, pending.generation);
 
-                impl->queue.queueTask(task);
-            }
+        TimerWheel::Timer timer;
+        timer.due = impl->currentTick() + _delay;
+        timer.interval = _interval;
+        timer.timer = pending.index;
+        {
+            std::lock_guard<std::mutex> lock(impl->timerGuard);
+            impl->timers.schedule(timer);
         }
+        impl->queue.wakeWorker();
 
-        return TaskId(rootOffset, root->generation);
+        return id;
     }
 
-    TaskId Scheduler::addStreamingTask(Kernel _kernel, void *_kernelData,
-        InputStream _is0, OutputStream _os0,
-        InputStream _is1, OutputStream _os1,
-        size_t _elementCount, size_t _elementsPerTask)
+    void Scheduler::finishTimer(PendingTimer* _timer)
     {
-        const size_t N = determineNumberOfTasks(_elementCount, _elementsPerTask);
-
-        // add a root task used for synchronisation
-        Task* root = impl->taskPool.obtainTask();
-        root->kernel = impl->emptyKernal;
-        root->openTasks = (_elementCount % N == 0) ? N + 1 : N + 2;
-        root->parent = Task::NO_PARENT;
-
-        TaskId::Offset rootOffset = impl->taskPool.getTaskOffset(root);
+        if (--_timer->openTasks == 0)
         {
-            // split the task into several subtasks, according to the size of the input/output streams
-            const size_t perElementCount = _elementCount / N;
-            for (int i = 0; i < N; ++i)
+            const TaskId::Offset parent = _timer->parent;
+            impl->timerTable.release(*_timer);
+            if (Task::isTimer(parent))
             {
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = perElementCount;
-
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + i*_is0.elementStride*perElementCount;
-
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + i*_os0.elementStride*perElementCount;
-
-                task->taskData.specificData.streamingData.inputStreams[1] =
-                    static_cast<char*>(_is1.data) + i*_is1.elementStride*perElementCount;
-
-                task->taskData.specificData.streamingData.outputStreams[1] =
-                    static_cast<char*>(_os1.data) + i*_os1.elementStride*perElementCount;
-
-                impl->queue.queueTask(task);
+                finishTimer(&impl->timerTable.get(static_cast<uint32_t>(parent - Task::FIRST_TIMER)));
             }
-
-            if (_elementCount % N != 0)
+            else if (parent != Task::NO_PARENT)
             {
-                const size_t handled = perElementCount * N;
-
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = _elementCount - handled;
-
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + N*_is0.elementStride*perElementCount;
+                finishTask(impl->taskPool.getTask(parent));
+            }
+        }
+    }
 
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + N*_os0.elementStride*perElementCount;
+    bool Scheduler::isFinished(const TaskId& _taskId)
+    {
+        if (Task::isTimer(_taskId.offset))
+        {
+            // a timer which has been released again finished before its slot was reused
+            PendingTimer* timer = getTimer(_taskId);
+            return !timer || timer->openTasks == 0;
+        }
+        return impl->taskPool.isTaskFinished(_taskId);
+    }
 
-                task->taskData.specificData.streamingData.inputStreams[1] =
-                    static_cast<char*>(_is1.data) + N*_is1.elementStride*perElementCount;
+    PendingTimer* Scheduler::getTimer(const TaskId& _taskId)
+    {
+        if (!Task::isTimer(_taskId.offset))
+        {
+            return nullptr;
+        }
 
-                task->taskData.specificData.streamingData.outputStreams[1] =
-                    static_cast<char*>(_os1.data) + N*_os1.elementStride*perElementCount;
+        PendingTimer& timer = impl->timerTable.get(static_cast<uint32_t>(_taskId.offset - Task::FIRST_TIMER));
+        return timer.generation == static_cast<int32_t>(_taskId.generation) ? &timer : nullptr;
+    }
 
-                impl->queue.queueTask(task);
-            }
-        }
+    TaskId Scheduler::addStreamingTask(Kernel _kernel, void *_kernelData,
+        InputStream _is0, OutputStream _os0,
+        size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment)
+    {
+        const InputStream inputs[] = { _is0 };
+        const OutputStream outputs[] = { _os0 };
+        return impl->core.addStreamingTask(*this, _kernel, _kernelData, inputs, outputs, 1, _elementCount, _elementsPerTask, _boundaryAlignment);
+    }
 
-        return TaskId(rootOffset, root->generation);
+    TaskId Scheduler::addStreamingTask(Kernel _kernel, void *_kernelData,
+        InputStream _is0, OutputStream _os0,
+        InputStream _is1, OutputStream _os1,
+        size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment)
+    {
+        const InputStream inputs[] = { _is0, _is1 };
+        const OutputStream outputs[] = { _os0, _os1 };
+        return impl->core.addStreamingTask(*this, _kernel, _kernelData, inputs, outputs, 2, _elementCount, _elementsPerTask, _boundaryAlignment);
     }
 
     TaskId Scheduler::addStreamingTask(Kernel _kernel, void *_kernelData,
         InputStream _is0, OutputStream _os0,
         InputStream _is1, OutputStream _os1,
         InputStream _is2, OutputStream _os2,
-        size_t _elementCount, size_t _elementsPerTask)
+        size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment)
     {
-        const size_t N = determineNumberOfTasks(_elementCount, _elementsPerTask);
+        const InputStream inputs[] = { _is0, _is1, _is2 };
+        const OutputStream outputs[] = { _os0, _os1, _os2 };
+        return impl->core.addStreamingTask(*this, _kernel, _kernelData, inputs, outputs, 3, _elementCount, _elementsPerTask, _boundaryAlignment);
+    }
 
-        // add a root task used for synchronisation
-        Task* root = impl->taskPool.obtainTask();
-        root->kernel = impl->emptyKernal;
-        root->openTasks = (_elementCount % N == 0) ? N + 1 : N + 2;
-        root->parent = Task::NO_PARENT;
+    TaskId Scheduler::addParallelFor2D(Kernel _kernel, void *_kernelData,
+        size_t _width, size_t _height,
+        const PitchedStream* _streams, size_t _streamCount,
+        size_t _tileWidth, size_t _tileHeight, bool _mortonOrder)
+    {
+        const size_t extents[] = { _width, _height, 1 };
+        const size_t tileShape[] = { _tileWidth, _tileHeight, 1 };
+        return splitTiles(_kernel, _kernelData, extents, _streams, _streamCount, tileShape, _mortonOrder);
+    }
 
-        TaskId::Offset rootOffset = impl->taskPool.getTaskOffset(root);
-        {
-            // split the task into several subtasks, according to the size of the input/output streams
-            const size_t perElementCount = _elementCount / N;
-            for (int i = 0; i < N; ++i)
-            {
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = perElementCount;
+    TaskId Scheduler::addParallelFor3D(Kernel _kernel, void *_kernelData,
+        size_t _width, size_t _height, size_t _depth,
+        const PitchedStream* _streams, size_t _streamCount,
+        size_t _tileWidth, size_t _tileHeight, size_t _tileDepth, bool _mortonOrder)
+    {
+        const size_t extents[] = { _width, _height, _depth };
+        const size_t tileShape[] = { _tileWidth, _tileHeight, _tileDepth };
+        return splitTiles(_kernel, _kernelData, extents, _streams, _streamCount, tileShape, _mortonOrder);
+    }
 
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + i*_is0.elementStride*perElementCount;
+    TaskId Scheduler::addMappedStreamingTask(Kernel _kernel, void *_kernelData,
+        const MappedFile& _input, size_t _inputStride,
+        MappedFile* _output, size_t _outputStride,
+        size_t _elementsPerTask, size_t _elementsPerWindow, bool* _accepted)
+    {
+        const size_t elementCount = _inputStride != 0 ? _input.size() / _inputStride : 0;
+        const MappedFile* source = &_input;
 
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + i*_os0.elementStride*perElementCount;
+        // every chunk of a window takes a slot of the task pool, so a window never has more chunks than a quarter of it
+        const size_t maximumWindow = std::max<size_t>(_elementsPerTask, 1) * (configuration::MAX_TASK_COUNT / 4);
+        const size_t window = std::min(_elementsPerWindow != 0 ? _elementsPerWindow : elementCount, maximumWindow);
 
-                task->taskData.specificData.streamingData.inputStreams[1] =
-                    static_cast<char*>(_is1.data) + i*_is1.elementStride*perElementCount;
+        // an output too small for every record would be written past its mapping, refuse it before anything runs
+        const bool accepted = !_output || _outputStride == 0 || _output->size() / _outputStride >= elementCount;
+        if (_accepted)
+        {
+            *_accepted = accepted;
+        }
+        if (!accepted)
+        {
+            return TaskId(Task::INLINED, 0);
+        }
 
-                task->taskData.specificData.streamingData.outputStreams[1] =
-                    static_cast<char*>(_os1.data) + i*_os1.elementStride*perElementCount;
+        // the windows are streamed one after another by a driver task, which helps out while it waits
+        return addTask(nullptr, [=](const TaskData& _data)
+        {
+            char* input = static_cast<char*>(source->data());
+            char* output = _output ? static_cast<char*>(_output->data()) : nullptr;
 
-                task->taskData.specificData.streamingData.inputStreams[2] =
-                    static_cast<char*>(_is2.data) + i*_is2.elementStride*perElementCount;
+            source->advise(0, window * _inputStride, MappedFile::WILL_NEED);
+            for (size_t first = 0; first < elementCount && !_data.isCancelled(); first += window)
+            {
+                const size_t count = window < elementCount - first ? window : elementCount - first;
+
+                // prefetch the next window while the current one is being processed
+                source->advise((first + count) * _inputStride, window * _inputStride, MappedFile::WILL_NEED);
+
+                // cancelling the driver cancels the window in flight as well
+                const InputStream inputs[] = { InputStream(input + first * _inputStride, _inputStride) };
+                const OutputStream outputs[] = { OutputStream(output ? output + first * _outputStride : nullptr, _outputStride) };
+                TaskId windowTask = impl->core.addStreamingTask(*this, _kernel, _kernelData, inputs, outputs, 1,
+                    count, _elementsPerTask, 0, _data.cancellation);
+                runTask(windowTask);
+                wait(windowTask);
+
+                source->advise(first * _inputStride, count * _inputStride, MappedFile::DONT_NEED);
+                if (_output)
+                {
+                    _output->flush(first * _outputStride, count * _outputStride);
+                    _output->advise(first * _outputStride, count * _outputStride, MappedFile::DONT_NEED);
+                }
+            }
+        });
+    }
 
-                task->taskData.specificData.streamingData.outputStreams[2] =
-                    static_cast<char*>(_os2.data) + i*_os2.elementStride*perElementCount;
+    TaskId Scheduler::addFusedStreamingTask(const KernelChain& _chain,
+        const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+        size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment)
+    {
+        std::vector<InputStream> inputs(_inputs, _inputs + _streamCount);
+        std::vector<OutputStream> outputs(_outputs, _outputs + _streamCount);
 
-                impl->queue.queueTask(task);
+        // every chunk task holds a copy of the fused kernel, so the segments are shared instead of copied with it
+        std::vector<Kernel> fused;
+        for (const KernelChain::Segment& segment : _chain.getSegments())
+        {
+            if (segment.empty())
+            {
+                continue;
             }
 
-            if (_elementCount % N != 0)
+            std::shared_ptr<const KernelChain::Segment> stages = std::make_shared<const KernelChain::Segment>(segment);
+            fused.push_back([stages](const TaskData& _data)
             {
-                const size_t handled = perElementCount * N;
-
-                Task* task = impl->taskPool.obtainTask();
-                task->kernel = _kernel;
-                task->parent = rootOffset;
-                task->taskData.kernelData = _kernelData;
-                task->taskData.specificData.streamingData.elementCount = _elementCount - handled;
-
-                task->taskData.specificData.streamingData.inputStreams[0] =
-                    static_cast<char*>(_is0.data) + N*_is0.elementStride*perElementCount;
+                TaskData data = _data;
+                for (const KernelChain::Stage& stage : *stages)
+                {
+                    if (_data.isCancelled())
+                    {
+                        return;
+                    }
+                    data.kernelData = stage.kernelData;
+                    stage.kernel(data);
+                }
+            });
+        }
 
-                task->taskData.specificData.streamingData.outputStreams[0] =
-                    static_cast<char*>(_os0.data) + N*_os0.elementStride*perElementCount;
+        // segments run one after another, the barrier between them is the driver waiting for the previous pass
+        return addTask(nullptr, [=](const TaskData& _data)
+        {
+            for (const Kernel& kernel : fused)
+            {
+                if (_data.isCancelled())
+                {
+                    return;
+                }
+
+                // cancelling the driver cancels the pass in flight as well, the token is chained before any chunk is queued
+                TaskId pass = impl->core.addStreamingTask(*this, kernel, nullptr, inputs.data(), outputs.data(), inputs.size(),
+                    _elementCount, _elementsPerTask, _boundaryAlignment, _data.cancellation);
+                runTask(pass);
+                wait(pass);
+            }
+        });
+    }
 
-                task->taskData.specificData.streamingData.inputStreams[1] =
-                    static_cast<char*>(_is1.data) + N*_is1.elementStride*perElementCount;
+    TaskId Scheduler::addIndexedStreamingTask(Kernel _kernel, void *_kernelData,
+        uint32_t* _indices, size_t _indexCount,
+        const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+        size_t _indicesPerTask, bool _sortChunks)
+    {
+        assert(_streamCount <= configuration::MAX_INDEXED_STREAMS);
 
-                task->taskData.specificData.streamingData.outputStreams[1] =
-                    static_cast<char*>(_os1.data) + N*_os1.elementStride*perElementCount;
+        // every chunk takes a slot of the task pool, chunks are grown if there would be more than a quarter of the pool
+        const size_t N = std::min<size_t>(BasicScheduler<DefaultSchedulerPolicy>::determineNumberOfTasks(_indexCount, _indicesPerTask),
+            configuration::MAX_TASK_COUNT / 4);
+        const size_t perTaskCount = (_indexCount + N - 1) / N;
+        const size_t chunkCount = perTaskCount != 0 ? (_indexCount + perTaskCount - 1) / perTaskCount : 0;
 
-                task->taskData.specificData.streamingData.inputStreams[2] =
-                    static_cast<char*>(_is2.data) + N*_is2.elementStride*perElementCount;
+        // sorting happens on the worker which runs the chunk, right before the kernel
+        Kernel kernel = _kernel;
+        if (_sortChunks)
+        {
+            kernel = [_kernel](const TaskData& _data)
+            {
+                const TaskData::IndexedData& indexedData = _data.specificData.indexedData;
+                std::sort(indexedData.indices, indexedData.indices + indexedData.indexCount);
+                _kernel(_data);
+            };
+        }
 
-                task->taskData.specificData.streamingData.outputStreams[2] =
-                    static_cast<char*>(_os2.data) + N*_os2.elementStride*perElementCount;
+        // add a root task used for synchronisation
+        Task* root = impl->taskPool.obtainTask();
+        root->kernel = impl->emptyKernal;
+        TaskId::Offset rootOffset = impl->taskPool.getTaskOffset(root);
+        TaskControl& rootControl = impl->taskPool.getControl(rootOffset);
+        rootControl.openTasks = chunkCount + 1;
+        rootControl.parent = Task::NO_PARENT;
 
-                impl->queue.queueTask(task);
+        for (size_t first = 0; first < _indexCount; first += perTaskCount)
+        {
+            Task* task = impl->taskPool.obtainTask();
+            task->kernel = kernel;
+            impl->taskPool.getControl(task).parent = rootOffset;
+            task->cancellation.parent = &root->cancellation;
+            task->taskData.kernelData = _kernelData;
+
+            TaskData::IndexedData& indexedData = task->taskData.specificData.indexedData;
+            indexedData.indices = _indices + first;
+            indexedData.indexCount = perTaskCount < _indexCount - first ? perTaskCount : _indexCount - first;
+            for (size_t s = 0; s != configuration::MAX_INDEXED_STREAMS; ++s)
+            {
+                indexedData.inputStreams[s] = s < _streamCount ? _inputs[s].data : nullptr;
+                indexedData.inputStrides[s] = s < _streamCount ? _inputs[s].elementStride : 0;
+                indexedData.outputStreams[s] = s < _streamCount ? _outputs[s].data : nullptr;
+                indexedData.outputStrides[s] = s < _streamCount ? _outputs[s].elementStride : 0;
             }
+
+            queueTask(task);
         }
 
-        return TaskId(rootOffset, root->generation);
+        return TaskId(rootOffset, rootControl.generation);
     }
 
-    void Scheduler::addChild(const TaskId& _parent, const TaskId& _child)
+    namespace
     {
-        Task* parentTask = impl->taskPool.getTask(_parent.offset);
-        parentTask->openTasks++;
+        /// Spreads the lower 21 bits of \a _value out to every third bit.
+        uint64_t spreadBits(uint64_t _value)
+        {
+            _value &= 0x1fffff;
+            _value = (_value | (_value << 32)) & 0x1f00000000ffffull;
+            _value = (_value | (_value << 16)) & 0x1f0000ff0000ffull;
+            _value = (_value | (_value << 8)) & 0x100f00f00f00f00full;
+            _value = (_value | (_value << 4)) & 0x10c30c30c30c30c3ull;
+            _value = (_value | (_value << 2)) & 0x1249249249249249ull;
+            return _value;
+        }
 
-        Task* childTask = impl->taskPool.getTask(_child.offset);
-        childTask->parent = _parent.offset;
-    }
+        uint64_t mortonCode(size_t _x, size_t _y, size_t _z)
+        {
+            return spreadBits(_x) | (spreadBits(_y) << 1) | (spreadBits(_z) << 2);
+        }
 
-    void Scheduler::runTask(const TaskId& _id)
-    {
-        Task* task = impl->taskPool.getTask(_id.offset);
-        impl->queue.queueTask(task);
+        struct Tile
+        {
+            uint64_t order;
+            size_t coordinates[3];
+
+            bool operator<(const Tile& _other) const { return order < _other.order; }
+        };
     }
 
-    void Scheduler::wait(const TaskId& _taskId)
+    TaskId Scheduler::splitTiles(Kernel _kernel, void *_kernelData, const size_t* _extents,
+        const PitchedStream* _streams, size_t _streamCount, const size_t* _tileShape, bool _mortonOrder)
     {
-        // wait until the task and all its children have completed
-        while (!impl->taskPool.isTaskFinished(_taskId))
+        assert(_streamCount <= configuration::MAX_TILE_STREAMS);
+
+        // tiles which are not given explicitly get an even share of the tile budget in every dimension
+        size_t bytesPerElement = 0;
+        for (size_t s = 0; s != _streamCount; ++s)
         {
-            helpWithWork();
+            bytesPerElement += _streams[s].elementStride;
         }
-    }
 
-    void Scheduler::waitWithoutHelping(const TaskId& _taskId)
-    {
-        while (!impl->taskPool.isTaskFinished(_taskId))
+        size_t budget = configuration::TILE_SIZE / (bytesPerElement != 0 ? bytesPerElement : 1);
+        size_t tile[3];
+        size_t unspecified = 0;
+        for (size_t d = 0; d != 3; ++d)
         {
-            std::this_thread::yield();
-        }
+            tile[d] = std::min(_tileShape[d], std::max<size_t>(_extents[d], 1));
+            if (tile[d] != 0)
+            {
+                budget /= tile[d];
+            }
+            else if (_extents[d] > 1)
+            {
+                ++unspecified;
+            }
+        }
+        budget = std::max<size_t>(budget, 1);
+
+        for (size_t d = 0; d != 3; ++d)
+        {
+            if (tile[d] != 0)
+            {
+                continue;
+            }
+            if (_extents[d] <= 1)
+            {
+                tile[d] = 1;
+                continue;
+            }
+
+            const size_t side = static_cast<size_t>(std::pow(static_cast<double>(budget), 1.0 / unspecified) + 0.5);
+            tile[d] = std::min(std::max<size_t>(side, 1), _extents[d]);
+            budget = std::max<size_t>(budget / tile[d], 1);
+            --unspecified;
+        }
+
+        // every tile takes a slot of the task pool, grow the tiles along the dimension with the most of them if needed
+        size_t tiles[3];
+        for (;;)
+        {
+            for (size_t d = 0; d != 3; ++d)
+            {
+                tiles[d] = (_extents[d] + tile[d] - 1) / tile[d];
+            }
+
+            const size_t largest = std::max_element(tiles, tiles + 3) - tiles;
+            if (tiles[0] * tiles[1] * tiles[2] <= configuration::MAX_TASK_COUNT / 4)
+            {
+                break;
+            }
+            tile[largest] = std::min(tile[largest] * 2, _extents[largest]);
+        }
+
+        std::vector<Tile> order;
+        order.reserve(tiles[0] * tiles[1] * tiles[2]);
+        for (size_t z = 0; z != tiles[2]; ++z)
+        {
+            for (size_t y = 0; y != tiles[1]; ++y)
+            {
+                for (size_t x = 0; x != tiles[0]; ++x)
+                {
+                    const Tile entry = { _mortonOrder ? mortonCode(x, y, z) : order.size(), { x, y, z } };
+                    order.push_back(entry);
+                }
+            }
+        }
+        if (_mortonOrder)
+        {
+            std::sort(order.begin(), order.end());
+        }
+
+        // add a root task used for synchronisation
+        Task* root = impl->taskPool.obtainTask();
+        root->kernel = impl->emptyKernal;
+        TaskId::Offset rootOffset = impl->taskPool.getTaskOffset(root);
+        TaskControl& rootControl = impl->taskPool.getControl(rootOffset);
+        rootControl.openTasks = order.size() + 1;
+        rootControl.parent = Task::NO_PARENT;
+
+        for (const Tile& entry : order)
+        {
+            Task* task = impl->taskPool.obtainTask();
+            task->kernel = _kernel;
+            impl->taskPool.getControl(task).parent = rootOffset;
+            task->cancellation.parent = &root->cancellation;
+            task->taskData.kernelData = _kernelData;
+
+            TaskData::TileData& tileData = task->taskData.specificData.tileData;
+            for (size_t d = 0; d != 3; ++d)
+            {
+                tileData.begin[d] = entry.coordinates[d] * tile[d];
+                tileData.end[d] = std::min(tileData.begin[d] + tile[d], _extents[d]);
+            }
+
+            for (size_t s = 0; s != configuration::MAX_TILE_STREAMS; ++s)
+            {
+                tileData.streams[s] = nullptr;
+                tileData.rowPitch[s] = 0;
+                tileData.slicePitch[s] = 0;
+                if (s < _streamCount)
+                {
+                    const PitchedStream& stream = _streams[s];
+                    tileData.streams[s] = static_cast<char*>(stream.data) + tileData.begin[0] * stream.elementStride +
+                        tileData.begin[1] * stream.rowPitch + tileData.begin[2] * stream.slicePitch;
+                    tileData.rowPitch[s] = stream.rowPitch;
+                    tileData.slicePitch[s] = stream.slicePitch;
+                }
+            }
+
+            queueTask(task);
+        }
+
+        return TaskId(rootOffset, rootControl.generation);
+    }
+
+    TaskId Scheduler::addReadTask(int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result)
+    {
+        return addIoTask(AsyncIo::READ, _fd, _buffer, _size, _offset, _result);
+    }
+
+    TaskId Scheduler::addWriteTask(int _fd, const void* _buffer, size_t _size, uint64_t _offset, int64_t* _result)
+    {
+        return addIoTask(AsyncIo::WRITE, _fd, const_cast<void*>(_buffer), _size, _offset, _result);
+    }
+
+    TaskId Scheduler::addIoTask(int _operation, int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result)
+    {
+        const AsyncIo::Operation operation = static_cast<AsyncIo::Operation>(_operation);
+
+        Task* task = impl->taskPool.obtainTask();
+        task->taskData.specificData.ioData.result = _result;
+
+        // the request is only submitted once the task runs, so it can be given a parent and children first
+        task->kernel = [=](const TaskData&)
+        {
+            // the completion counts the task down as well, so it finishes once the I/O is done rather than this kernel
+            TaskControl& control = impl->taskPool.getControl(task);
+            control.openTasks++;
+            if (impl->io.submit(operation, _fd, _buffer, _size, _offset, task))
+            {
+                // make sure somebody polls for the completion
+                impl->queue.wakeWorker();
+                return;
+            }
+            control.openTasks--;
+
+            // io_uring is not available, the ring is full or the request too large for it, do blocking I/O right here
+            const int64_t result = operation == AsyncIo::READ ?
+                AsyncIo::read(_fd, _buffer, _size, _offset) : AsyncIo::write(_fd, _buffer, _size, _offset);
+            if (_result)
+            {
+                *_result = result;
+            }
+        };
+        return impl->taskPool.getTaskId(task);
+    }
+
+    void Scheduler::addChild(const TaskId& _parent, const TaskId& _child)
+    {
+        if (_child.offset == Task::INLINED)
+        {
+            // the child has already run to completion
+            return;
+        }
+        if (_parent.offset == Task::INLINED)
+        {
+            // the parent has already finished and has no control block to count in, the child runs on its own
+            return;
+        }
+
+        // timers count their children like tasks do, their children are told apart by Task::timer
+        PendingTimer* parentTimer = getTimer(_parent);
+        PendingTimer* childTimer = getTimer(_child);
+        if ((Task::isTimer(_child.offset) && !childTimer) || (Task::isTimer(_parent.offset) && !parentTimer))
+        {
+            // a stale timer id belongs to a timer which has fired and finished, like an inlined task
+            return;
+        }
+
+        const CancellationToken* parentToken = nullptr;
+        if (parentTimer)
+        {
+            parentTimer->openTasks++;
+            parentToken = &parentTimer->cancellation;
+        }
+        else
+        {
+            impl->taskPool.getControl(_parent.offset).openTasks++;
+            parentToken = &impl->taskPool.getTask(_parent.offset)->cancellation;
+        }
+
+        if (childTimer)
+        {
+            childTimer->parent = _parent.offset;
+            childTimer->cancellation.parent = parentToken;
+            return;
+        }
+
+        Task* childTask = impl->taskPool.getTask(_child.offset);
+        if (parentTimer)
+        {
+            childTask->timer = parentTimer;
+        }
+        else
+        {
+            impl->taskPool.getControl(_child.offset).parent = _parent.offset;
+        }
+        childTask->cancellation.parent = parentToken;
+    }
+
+    void Scheduler::runTask(const TaskId& _id)
+    {
+        if (_id.offset == Task::INLINED || Task::isTimer(_id.offset))
+        {
+            // inlined tasks have run already, timers release their tasks themselves, stale timer ids included
+            return;
+        }
+
+        Task* task = impl->taskPool.getTask(_id.offset);
+        queueTask(task);
+    }
+
+    void Scheduler::queueTask(Task* _task)
+    {
+        if (impl->schedulingPolicy == CRITICAL_PATH)
+        {
+            _task->priority = remainingPath(_task);
+        }
+        impl->core.queueTask(_task);
+
+        if (impl->elastic)
+        {
+            impl->threads.growIfBackedUp();
+        }
+    }
+
+    uint64_t Scheduler::remainingPath(Task* _task)
+    {
+        // children finish before their parents, so the path to the root is the chain of parents
+        uint64_t path = impl->durations.estimate(durationKey(_task));
+        TaskId::Offset parent = impl->taskPool.getControl(_task).parent;
+        while (parent != Task::NO_PARENT)
+        {
+            _task = impl->taskPool.getTask(parent);
+            parent = impl->taskPool.getControl(parent).parent;
+            path += impl->durations.estimate(durationKey(_task));
+        }
+        return path;
+    }
+
+    uint64_t Scheduler::durationKey(Task* _task)
+    {
+        if (_task->durationKey != 0 || !_task->kernel)
+        {
+            return _task->durationKey;
+        }
+
+        uint64_t key = 14695981039346656037ull;
+        if (_task->label)
+        {
+            for (const char* c = _task->label; *c; ++c)
+            {
+                key = (key ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+            }
+        }
+        else
+        {
+            // lambdas and functors each have their own type, plain functions are told apart by their address
+            key ^= _task->kernel.target_type().hash_code();
+            typedef void (*KernelFunction)(const TaskData&);
+            if (const KernelFunction* function = _task->kernel.target<KernelFunction>())
+            {
+                key = (key ^ reinterpret_cast<uintptr_t>(*function)) * 1099511628211ull;
+            }
+        }
+
+        _task->durationKey = key != 0 ? key : 1;
+        return _task->durationKey;
+    }
+
+    void Scheduler::setSchedulingPolicy(SchedulingPolicy _policy)
+    {
+        impl->schedulingPolicy = _policy;
+        impl->queue.setPrioritised(_policy == CRITICAL_PATH);
+    }
+
+    void Scheduler::setLabel(const TaskId& _taskId, const char* _label)
+    {
+        if (_taskId.offset == Task::INLINED)
+        {
+            return;
+        }
+
+        if (Task::isTimer(_taskId.offset))
+        {
+            if (PendingTimer* timer = getTimer(_taskId))
+            {
+                timer->label = _label;
+            }
+            return;
+        }
+
+        Task* task = impl->taskPool.getTask(_taskId.offset);
+        task->label = _label;
+        task->durationKey = 0;
+    }
+
+    void Scheduler::cancel(const TaskId& _taskId)
+    {
+        if (_taskId.offset == Task::INLINED)
+        {
+            return;
+        }
+
+        if (Task::isTimer(_taskId.offset))
+        {
+            if (PendingTimer* timer = getTimer(_taskId))
+            {
+                timer->cancellation.cancelled.store(true, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        impl->core.cancel(_taskId);
+    }
+
+    bool Scheduler::isCancelled(const TaskId& _taskId)
+    {
+        if (_taskId.offset == Task::INLINED)
+        {
+            return false;
+        }
+
+        if (Task::isTimer(_taskId.offset))
+        {
+            PendingTimer* timer = getTimer(_taskId);
+            return timer && timer->cancellation.isCancelled();
+        }
+
+        Task* task = impl->taskPool.getTask(_taskId.offset);
+        if (impl->taskPool.getControl(_taskId.offset).generation != static_cast<int32_t>(_taskId.generation))
+        {
+            return false;
+        }
+        return task->cancellation.isCancelled();
+    }
+
+    void Scheduler::setScratchReset(ScratchReset _mode)
+    {
+        impl->scratchReset = _mode;
+    }
+
+    void Scheduler::resetScratchArenas()
+    {
+        for (auto& arena : impl->scratchArenas)
+        {
+            arena->reset();
+        }
+        ++impl->scratchEpoch;
+    }
+
+    void Scheduler::resetFrameArena()
+    {
+        impl->frameArena.reset();
+    }
+
+    size_t Scheduler::getScratchHighWaterMark() const
+    {
+        size_t highWaterMark = impl->externalScratchHighWater.load(std::memory_order_relaxed);
+        for (auto& arena : impl->scratchArenas)
+        {
+            highWaterMark = arena->highWaterMark() > highWaterMark ? arena->highWaterMark() : highWaterMark;
+        }
+        return highWaterMark;
+    }
+
+    size_t Scheduler::getFrameArenaHighWaterMark() const
+    {
+        return impl->frameArena.highWaterMark();
+    }
+
+    void Scheduler::wait(const TaskId& _taskId)
+    {
+        // wait until the task and all its children have completed
+        while (!isFinished(_taskId))
+        {
+            helpWithWork();
+        }
+    }
+
+    void Scheduler::waitWithoutHelping(const TaskId& _taskId)
+    {
+        while (!isFinished(_taskId))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    bool Scheduler::attachCurrentThread()
+    {
+        if (threadType != MAIN)
+        {
+            // already a worker, either from the pool or attached earlier
+            return false;
+        }
+
+        const int number = impl->threads.acquireIdentity();
+        if (number < 0)
+        {
+            return false;
+        }
+
+        threadType = static_cast<ThreadType>(ThreadType::TASK0 + number);
+        attachedThread = true;
+        return true;
+    }
+
+    void Scheduler::detach()
+    {
+        if (!attachedThread)
+        {
+            // pool threads keep their identity until they exit
+            return;
+        }
+
+        impl->threads.releaseIdentity(threadType - ThreadType::TASK0);
+        threadType = MAIN;
+        attachedThread = false;
+    }
+
+    void Scheduler::runUntil(const std::function<bool()>& _predicate)
+    {
+        // threads which are already workers keep their identity, everybody else borrows one for the duration
+        const bool attached = attachCurrentThread();
+        while (!_predicate())
+        {
+            helpWithWork();
+        }
+
+        if (attached)
+        {
+            detach();
+        }
     }
 
     void Scheduler::helpWithWork(void)
     {
+        if (impl->elastic)
+        {
+            impl->threads.growIfBackedUp();
+        }
+
         Task* task = impl->queue.getAvailableTask();
         if (task)
         {
+            serviceIfDue();
             workOnTask(task);
         }
         else
         {
+            serviceIdle();
             std::this_thread::yield();
         }
     }
 
-    void Scheduler::workOnTask(Task* _task)
+    int Scheduler::serviceIdle()
     {
-        while (!canExecuteTask(_task))
+        const int timeout = serviceTimers();
+        if (!impl->io.hasPendingRequests())
         {
-            // the task cannot be executed at this time, work on another item
-            helpWithWork();
+            return timeout;
+        }
+
+        // I/O completions are polled rather than signalled, so check back soon
+        serviceIo();
+        return 1;
+    }
+
+    void Scheduler::serviceIfDue()
+    {
+        // reading the clock is cheap, the wheel is locked and I/O is polled at most once per tick
+        if (impl->currentTick() != impl->servicedTick.load(std::memory_order_relaxed))
+        {
+            serviceIdle();
+        }
+    }
+
+    void Scheduler::serviceIo()
+    {
+        std::vector<AsyncIo::Completion> completions;
+        impl->io.poll(completions);
+
+        for (const AsyncIo::Completion& completion : completions)
+        {
+            Task* task = static_cast<Task*>(completion.userData);
+            if (task->taskData.specificData.ioData.result)
+            {
+                *task->taskData.specificData.ioData.result = completion.result;
+            }
+            finishTask(task);
+        }
+    }
+
+    int Scheduler::serviceTimers()
+    {
+        std::unique_lock<std::mutex> lock(impl->timerGuard, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            // somebody else is servicing the wheel, check back soon
+            return 1;
+        }
+
+        const uint64_t now = impl->currentTick();
+        impl->servicedTick.store(now, std::memory_order_relaxed);
+        impl->expiredTimers.clear();
+        impl->dueTasks.clear();
+        impl->timers.advance(now, impl->expiredTimers);
+
+        // keep part of the pool for regular work, timers which do not fit any more fire on the next tick
+        size_t available = impl->taskPool.getAvailableTaskCount();
+        available = available > configuration::MAX_TASK_COUNT / 4 ? available - configuration::MAX_TASK_COUNT / 4 : 0;
+
+        for (TimerWheel::Timer& timer : impl->expiredTimers)
+        {
+            PendingTimer& pending = impl->timerTable.get(timer.timer);
+            if (pending.cancellation.isCancelled())
+            {
+                // a cancelled timer finishes once the last task it released has run
+                finishTimer(&pending);
+                continue;
+            }
+
+            if (available == 0)
+            {
+                timer.due = now + 1;
+                impl->timers.schedule(timer);
+                continue;
+            }
+            --available;
+
+            Task* task = impl->taskPool.obtainTask();
+            task->kernel = pending.kernel;
+            task->taskData.kernelData = pending.kernelData;
+            task->label = pending.label;
+            task->cancellation.parent = &pending.cancellation;
+            task->timer = &pending;
+            impl->dueTasks.push_back(task);
+
+            if (timer.interval == 0)
+            {
+                // the delayed task takes over the timer's own count
+                continue;
+            }
+
+            pending.openTasks++;
+
+            // skip periods which were missed instead of releasing them all at once
+            timer.due += timer.interval;
+            if (timer.due <= now)
+            {
+                timer.due = now + timer.interval;
+            }
+            impl->timers.schedule(timer);
         }
 
-        // execute the kernel and finish the task
-        if (_task->kernel)
+        // release the due tasks in one batch, ahead of whatever has been queued while they waited
+        if (!impl->dueTasks.empty())
         {
-            (_task->kernel)(_task->taskData);
+            if (impl->schedulingPolicy == CRITICAL_PATH)
+            {
+                for (Task* task : impl->dueTasks)
+                {
+                    task->priority = remainingPath(task);
+                }
+            }
+            impl->queue.queueUrgentTasks(impl->dueTasks.data(), impl->dueTasks.size());
         }
 
-        finishTask(_task);
+        const uint64_t ticks = impl->timers.ticksUntilNextEvent();
+        return ticks < 1000 ? static_cast<int>(ticks) : 1000;
     }
 
-    void Scheduler::finishTask(Task* task)
+    void Scheduler::workOnTask(Task* _task)
     {
-        const size_t openTasks = (--task->openTasks);
+        impl->core.workOnTask(*this, _task);
+    }
 
-        if (openTasks == 0)
+    void Scheduler::runKernel(Task* _task)
+    {
+        // execute the kernel unless the task tree has been cancelled, the task is finished either way
+        if (_task->kernel && !_task->cancellation.isCancelled())
         {
-            if (task->parent != Task::NO_PARENT)
+            LinearArena* scratch = scratchOfCurrentThread();
+            _task->taskData.scratch = scratch;
+            _task->taskData.frame = &impl->frameArena;
+
+            // nested tasks run while this one waits, so releasing up to the mark keeps their allocations apart
+            const size_t mark = scratch->mark();
+
+            PerfCounters* counters = impl->perfCountersEnabled.load(std::memory_order_relaxed) ? countersOfCurrentThread() : nullptr;
+            PerfCounters::Sample before;
+            if (counters && !counters->read(before))
+            {
+                counters = nullptr;
+            }
+
+            if (impl->schedulingPolicy == CRITICAL_PATH)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                (_task->kernel)(_task->taskData);
+                const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                impl->durations.record(durationKey(_task), duration.count());
+            }
+            else
+            {
+                (_task->kernel)(_task->taskData);
+            }
+
+            PerfCounters::Sample after;
+            if (counters && counters->read(after))
             {
-                // tell our parent that we're finished
-                Task* parent = impl->taskPool.getTask(task->parent);
-                finishTask(parent);
+                recordCounters(_task, before.values, after.values);
             }
 
-            // this task has finished completely, remove it
-            impl->taskPool.returnTask(task);
+            if (threadType == MAIN)
+            {
+                // the arena belongs to the thread, so its peak is kept here for getScratchHighWaterMark
+                const size_t highWaterMark = scratch->highWaterMark();
+                size_t peak = impl->externalScratchHighWater.load(std::memory_order_relaxed);
+                while (highWaterMark > peak && !impl->externalScratchHighWater.compare_exchange_weak(peak, highWaterMark))
+                {
+                }
+            }
+
+            if (impl->scratchReset == PER_TASK)
+            {
+                scratch->rewind(mark);
+            }
+        }
+    }
+
+    LinearArena* Scheduler::scratchOfCurrentThread()
+    {
+        if (threadType != MAIN)
+        {
+            return impl->scratchArenas[threadType - ThreadType::TASK0].get();
+        }
+
+        // no tasks run while resetScratchArenas is called, so a thread without identity resets its arena on its next task
+        ExternalThreadState& state = externalThreadOf(impl->instance);
+        const uint64_t epoch = impl->scratchEpoch.load();
+        if (state.scratchEpoch != epoch)
+        {
+            state.scratch->reset();
+            state.scratchEpoch = epoch;
         }
+        return state.scratch.get();
     }
 
-    size_t Scheduler::determineNumberOfTasks(size_t _elementCount, size_t _elementsPerTask)
+    PerfCounters* Scheduler::countersOfCurrentThread()
     {
-        size_t numberOftasks = _elementCount / _elementsPerTask;
+        // groups count the thread which opened them, so they are reopened when an identity moves to another thread, threads
+        // without an identity own a group each
+        PerfCounters* counters = threadType != MAIN ? impl->perfCounters[threadType - ThreadType::TASK0].get() :
+            externalThreadOf(impl->instance).counters.get();
+        if (!counters->isOwnedByCurrentThread() && !counters->open())
+        {
+            return nullptr;
+        }
+        return counters;
+    }
+
+    void Scheduler::recordCounters(Task* _task, const uint64_t* _before, const uint64_t* _after)
+    {
+        const uint64_t key = durationKey(_task);
+
+        std::lock_guard<std::mutex> lock(impl->kernelCountersGuard);
+        auto inserted = impl->kernelCounters.insert(std::make_pair(key, KernelCounters()));
+        KernelCounters& counters = inserted.first->second;
+        if (inserted.second)
+        {
+            counters = KernelCounters();
+            counters.key = key;
+            counters.label = _task->label;
+        }
 
-        return numberOftasks != 0 ? numberOftasks : 1;
+        ++counters.runs;
+        counters.cycles += _after[PerfCounters::CYCLES] - _before[PerfCounters::CYCLES];
+        counters.instructions += _after[PerfCounters::INSTRUCTIONS] - _before[PerfCounters::INSTRUCTIONS];
+        counters.llcMisses += _after[PerfCounters::LLC_MISSES] - _before[PerfCounters::LLC_MISSES];
+        counters.branchMisses += _after[PerfCounters::BRANCH_MISSES] - _before[PerfCounters::BRANCH_MISSES];
     }
 
-    bool Scheduler::canExecuteTask(Task* _task)
+    bool Scheduler::enablePerfCounters(bool _enable)
     {
-        if (_task->parent == Task::NO_PARENT)
+        if (!_enable)
         {
+            impl->perfCountersEnabled.store(false);
             return true;
         }
 
-        return _task->openTasks == 1;
+        // probe on the calling thread, if perf events are not permitted here they are not permitted on the workers either
+        PerfCounters probe;
+        const bool enabled = probe.open();
+        impl->perfCountersEnabled.store(enabled);
+        return enabled;
+    }
+
+    std::vector<KernelCounters> Scheduler::getKernelCounters() const
+    {
+        std::vector<KernelCounters> result;
+        {
+            std::lock_guard<std::mutex> lock(impl->kernelCountersGuard);
+            for (const auto& entry : impl->kernelCounters)
+            {
+                result.push_back(entry.second);
+            }
+        }
+
+        std::sort(result.begin(), result.end(), [](const KernelCounters& _a, const KernelCounters& _b) { return _a.cycles > _b.cycles; });
+        return result;
+    }
+
+    void Scheduler::resetKernelCounters()
+    {
+        std::lock_guard<std::mutex> lock(impl->kernelCountersGuard);
+        impl->kernelCounters.clear();
+    }
+
+    std::string Scheduler::getKernelCounterReport() const
+    {
+        std::string report;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-24s %10s %14s %14s %6s %12s %12s\n",
+            "kernel", "runs", "cycles", "instructions", "IPC", "LLC misses", "br misses");
+        report += line;
+
+        for (const KernelCounters& counters : getKernelCounters())
+        {
+            char name[32];
+            if (counters.label)
+            {
+                std::snprintf(name, sizeof(name), "%s", counters.label);
+            }
+            else
+            {
+                std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(counters.key));
+            }
+
+            // low IPC together with many LLC misses points to a kernel bound by memory rather than by compute
+            const double ipc = counters.cycles != 0 ? static_cast<double>(counters.instructions) / counters.cycles : 0.0;
+            std::snprintf(line, sizeof(line), "%-24s %10llu %14llu %14llu %6.2f %12llu %12llu\n", name,
+                static_cast<unsigned long long>(counters.runs), static_cast<unsigned long long>(counters.cycles),
+                static_cast<unsigned long long>(counters.instructions), ipc,
+                static_cast<unsigned long long>(counters.llcMisses), static_cast<unsigned long long>(counters.branchMisses));
+            report += line;
+        }
+        return report;
+    }
+
+    void Scheduler::finishTask(Task* _task)
+    {
+        impl->core.finishTask(*this, _task);
+    }
+
+    void Scheduler::taskFinished(Task* _task)
+    {
+        if (_task->timer)
+        {
+            // tell the timer which released us
+            finishTimer(_task->timer);
+        }
     }
 }
\ No newline at end of file
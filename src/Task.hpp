@@ -4,10 +4,16 @@
 #include <thread>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <string>
+#include <mutex>
 
 #include "TaskCore.hpp"
-#include "TaskPool.hpp"
-#include "LockingQueue.hpp"
+#include "BasicScheduler.hpp"
+#include "MappedFile.hpp"
+#include "KernelChain.hpp"
+#include "PerfCounters.hpp"
+#include "DurationHistory.hpp"
 
 namespace orbit
 {
@@ -31,21 +37,8 @@ namespace orbit
 #endif
     const char* ThreadName();
 
-    class TaskQueue
-    {
-    public:
-        /// Tries to queue a task.
-        void queueTask(Task* task);
-
-        /// Waits the calling thread until a task becomes available in the queue.
-        Task* waitUntilTaskIsAvailable();
-
-        /// Tries to get a task from the queue, returns \c nullptr if no task is currently available.
-        Task* getAvailableTask(void);
-
-    private:
-        LockingQueue<Task*> queue;
-    };
+    /// The queue Scheduler shares with its BasicScheduler core.
+    typedef BasicTaskQueue<Task, DefaultSchedulerPolicy> TaskQueue;
 
     class Scheduler;
     class ThreadPool
@@ -55,18 +48,54 @@ namespace orbit
         ThreadPool(const ThreadPool &) = delete;
 
         void initialise(uint8_t _numberOfThreads);
-        void initialiseThread();
 
-        void work();
+        /// Starts \a _minimum threads and adds more up to \a _maximum while the queue stays backed up. Threads beyond the
+        /// minimum retire after being idle for \a _idleTimeout.
+        void initialise(uint8_t _minimum, uint8_t _maximum, std::chrono::milliseconds _idleTimeout);
+        void initialiseThread(unsigned int _slot, int _number);
+
+        void work(unsigned int _slot);
         void shutdown();
 
+        /// Adds a thread if the queue has been backed up for a while and the maximum has not been reached.
+        void growIfBackedUp();
+
+        bool allThreadsBusy() const;
+        int getThreadCount() const { return runningThreads.load(std::memory_order_relaxed); }
+
+        /// Claims a free worker identity, returns -1 if all MAX_WORKER_THREAD_COUNT identities are in use.
+        int acquireIdentity();
+        void releaseIdentity(int _number);
+
     private:
+        enum SlotState
+        {
+            EMPTY,
+            RUNNING,
+            RETIRED,
+        };
+
+        /// Returns \c false if no worker identity is left for the new thread.
+        bool startThread(unsigned int _slot);
+        bool retire(unsigned int _slot);
+
         TaskQueue &queue;
         Scheduler &scheduler;
 
-        std::atomic<int> threadNumber;
+        std::atomic<uint32_t> identities;
+        std::atomic<int> busyThreads;
+        std::atomic<int> runningThreads;
         std::atomic<bool> shouldRun;
-        std::vector<std::thread> threads;
+
+        int minimumThreads;
+        int maximumThreads;
+        std::chrono::milliseconds idleTimeout;
+
+        // threads live in fixed slots, retired ones are joined when their slot is reused
+        std::mutex slotGuard;
+        std::atomic<int> slotStates[configuration::MAX_WORKER_THREAD_COUNT];
+        std::thread threads[configuration::MAX_WORKER_THREAD_COUNT];
+        std::atomic<int64_t> backedUpSince;
     };
 
 
@@ -75,43 +104,199 @@ namespace orbit
     public:
         class Pimpl;
 
+        enum ScratchReset
+        {
+            /// Scratch allocations of a kernel are released as soon as its task has finished.
+            PER_TASK,
+            /// Scratch allocations stay valid until resetScratchArenas is called.
+            PER_FRAME,
+        };
+
+        enum SchedulingPolicy
+        {
+            /// Tasks run in the order they were queued.
+            FIFO,
+            /// Ready tasks with the longest expected path to their root run first, based on measured kernel durations.
+            CRITICAL_PATH,
+        };
+
         Scheduler();
         ~Scheduler();
         void initialise(uint8_t _cores);
 
+        /// Starts \a _minimumCores workers and adds more, up to \a _maximumCores, while the queue stays backed up. Workers
+        /// beyond the minimum retire after \a _idleTimeout without work. Both counts are capped by a cgroup CPU quota.
+        void initialise(uint8_t _minimumCores, uint8_t _maximumCores, std::chrono::milliseconds _idleTimeout);
+
+        /// Number of currently running workers.
+        int getWorkerCount() const;
+
         TaskId addTask(void *_kernelData, Kernel _kernel);
         TaskId addAndRunTask(void *_kernelData, Kernel _kernel);
         TaskId addEmptyTask();
 
+        /// Adds a task which is queued once \a _delay has elapsed, ahead of the tasks queued in the meantime.
+        TaskId addDelayedTask(std::chrono::milliseconds _delay, void *_kernelData, Kernel _kernel);
+
+        /// Adds a task which runs every \a _interval until it is cancelled. The returned task only finishes after cancellation.
+        TaskId addPeriodicTask(std::chrono::milliseconds _interval, void *_kernelData, Kernel _kernel);
+
+        /// Splits the streams into chunks of about \a _elementsPerTask elements. A \a _boundaryAlignment in bytes, such as
+        /// configuration::CACHE_LINE_SIZE or the vector width, rounds chunk boundaries so every stream of a chunk starts
+        /// aligned, leftover elements go to a head and a tail chunk.
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0, 
-            size_t elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
 
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0, 
             InputStream _is1, OutputStream _os1,
-            size_t _elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
 
         TaskId addStreamingTask(Kernel _kernel, void *_kernelData,
             InputStream _is0, OutputStream _os0, 
             InputStream _is1, OutputStream _os1,
             InputStream _is2, OutputStream _os2, 
-            size_t _elementCount, size_t _elementsPerTask);
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
 
+        /// Runs \a _kernel over the elements named by \a _indices instead of a contiguous range, so sparse data needs no
+        /// compaction. Every chunk gets its slice of the index list together with the base address and stride of every
+        /// stream and gathers and scatters through them. With \a _sortChunks each chunk first sorts its slice of \a _indices
+        /// in place, which walks the streams in address order. Up to three streams are supported, chunks are grown if there
+        /// would be more than a quarter of the task pool.
+        TaskId addIndexedStreamingTask(Kernel _kernel, void *_kernelData,
+            uint32_t* _indices, size_t _indexCount,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _indicesPerTask, bool _sortChunks = false);
+
+        /// Splits a grid of elements into tiles and runs \a _kernel on every tile. A tile size of zero picks tiles of about
+        /// configuration::TILE_SIZE bytes across all streams, tiles are grown if there would be more than a quarter of the
+        /// task pool. With \a _mortonOrder tiles are queued along a Z-order curve instead of row by row. Up to three streams
+        /// are supported.
+        TaskId addParallelFor2D(Kernel _kernel, void *_kernelData,
+            size_t _width, size_t _height,
+            const PitchedStream* _streams, size_t _streamCount,
+            size_t _tileWidth = 0, size_t _tileHeight = 0, bool _mortonOrder = false);
+
+        TaskId addParallelFor3D(Kernel _kernel, void *_kernelData,
+            size_t _width, size_t _height, size_t _depth,
+            const PitchedStream* _streams, size_t _streamCount,
+            size_t _tileWidth = 0, size_t _tileHeight = 0, size_t _tileDepth = 0, bool _mortonOrder = false);
+
+        /// Runs every segment of \a _chain as one streaming pass over the given streams, all kernels of a segment run on a
+        /// chunk one after another and see the same stream addresses. Segments are separated by the barriers of the chain.
+        /// The chain is copied, the streams have to stay valid until the returned task has finished. The returned driver has to
+        /// be run like the root of addStreamingTask.
+        TaskId addFusedStreamingTask(const KernelChain& _chain,
+            const InputStream* _inputs, const OutputStream* _outputs, size_t _streamCount,
+            size_t _elementCount, size_t _elementsPerTask, size_t _boundaryAlignment = 0);
+
+        /// Streams the records of a mapped file through \a _kernel, one window of \a _elementsPerWindow records at a time.
+        /// The next window is prefetched while the current one runs and finished windows are released again. Zero, or a
+        /// window with more chunks than a quarter of the task pool, is capped to that quarter. The returned driver has to be
+        /// run like the root of addStreamingTask. \a _output is optional, otherwise it has to hold a record of
+        /// \a _outputStride bytes for every input record. If it is smaller than that nothing is streamed, \a _accepted
+        /// receives \c false and the returned task has already finished. Both files have to stay open until the returned
+        /// task has finished.
+        TaskId addMappedStreamingTask(Kernel _kernel, void *_kernelData,
+            const MappedFile& _input, size_t _inputStride,
+            MappedFile* _output, size_t _outputStride,
+            size_t _elementsPerTask, size_t _elementsPerWindow, bool* _accepted = nullptr);
+
+        /// Reads or writes \a _size bytes at \a _offset of \a _fd. The request is submitted once the returned task is run, so it
+        /// can be given a parent and children like any other task, and the task finishes once the I/O has completed.
+        /// \a _result receives the number of bytes transferred or a negative error code, a cancelled request is never
+        /// submitted. Requests go through io_uring where available and are otherwise done as blocking I/O by the task.
+        TaskId addReadTask(int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result = nullptr);
+        TaskId addWriteTask(int _fd, const void* _buffer, size_t _size, uint64_t _offset, int64_t* _result = nullptr);
+
+        /// Makes \a _parent wait for \a _child. Tasks which were run inline and timers which have fired and finished have
+        /// finished already, such a child is not waited for and the children of such a parent run on their own.
         void addChild(const TaskId& _parent, const TaskId& _child);
         void runTask(const TaskId& _id);
 
+        /// Cancels a task and every task beneath it. Queued tasks of a cancelled tree are finished without running their kernel.
+        void cancel(const TaskId& _taskId);
+        bool isCancelled(const TaskId& _taskId);
+
+        /// Has to be called before any task is queued.
+        void setSchedulingPolicy(SchedulingPolicy _policy);
+
+        /// Kernel durations are recorded per label, tasks without one are keyed by the identity of their kernel.
+        void setLabel(const TaskId& _taskId, const char* _label);
+
+        /// Lets addAndRunTask run the kernel right away on the calling thread once \a _queueDepth tasks are queued or every
+        /// worker is busy. The returned id is already finished. Zero, the default, turns inlining off.
+        void setInlineCutoff(size_t _queueDepth);
+        size_t getInlinedTaskCount() const;
+
+        void setScratchReset(ScratchReset _mode);
+
+        /// Releases all scratch allocations of every worker and every other thread which ran tasks, no tasks may be running.
+        void resetScratchArenas();
+
+        /// Releases all frame arena allocations, no tasks may be running.
+        void resetFrameArena();
+
+        size_t getScratchHighWaterMark() const;
+        size_t getFrameArenaHighWaterMark() const;
+
+        /// Reads cycles, instructions, LLC misses and branch misses around every kernel run and sums them up per kernel,
+        /// kernels are told apart as for CRITICAL_PATH. Counts of a kernel include the tasks it helps with while it waits.
+        /// Returns \c false and stays disabled if perf events are not available or not permitted.
+        bool enablePerfCounters(bool _enable);
+        std::vector<KernelCounters> getKernelCounters() const;
+        void resetKernelCounters();
+
+        /// One line per kernel, the most expensive kernels first.
+        std::string getKernelCounterReport() const;
+
+        /// Gives the calling thread a worker identity of its own, so it works on tasks with a worker's scratch arena.
+        /// Returns \c false if the thread already is a worker or all worker identities are taken.
+        bool attachCurrentThread();
+
+        /// Hands the identity obtained by attachCurrentThread back, pool threads and threads which never attached are left alone.
+        void detach();
+
+        /// Works on queued tasks until \a _predicate returns \c true, attaching the calling thread for the duration if needed.
+        void runUntil(const std::function<bool()>& _predicate);
+
         void wait(const TaskId& _taskId);
         void waitWithoutHelping(const TaskId& _taskId);
 
         void workOnTask(Task* _task);
 
+        /// Releases due timers into the queue and completes finished I/O, returns how many milliseconds the caller may
+        /// wait for work.
+        int serviceIdle();
+
+        /// Services timers and I/O completions if that has not happened during the current tick, called between tasks.
+        void serviceIfDue();
+
     private:
         void helpWithWork();
-        void finishTask(Task* task);
-        bool canExecuteTask(Task* _task);
+        void queueTask(Task* _task);
+        void runKernel(Task* _task);
+        LinearArena* scratchOfCurrentThread();
+        PerfCounters* countersOfCurrentThread();
+        void recordCounters(Task* _task, const uint64_t* _before, const uint64_t* _after);
+        bool shouldRunInline() const;
+        uint64_t durationKey(Task* _task);
+        uint64_t remainingPath(Task* _task);
+        int serviceTimers();
+        TaskId addTimer(uint64_t _delay, uint64_t _interval, void *_kernelData, Kernel _kernel);
+        void finishTimer(PendingTimer* _timer);
+        PendingTimer* getTimer(const TaskId& _taskId);
+        bool isFinished(const TaskId& _taskId);
+        void serviceIo();
+        TaskId addIoTask(int _operation, int _fd, void* _buffer, size_t _size, uint64_t _offset, int64_t* _result);
+        TaskId splitTiles(Kernel _kernel, void *_kernelData, const size_t* _extents,
+            const PitchedStream* _streams, size_t _streamCount, const size_t* _tileShape, bool _mortonOrder);
+        void finishTask(Task* _task);
+        void taskFinished(Task* _task);
 
-        size_t determineNumberOfTasks(size_t _elementCount, size_t _elementsPerTask);
+        // the core calls back into runKernel, taskFinished, queueTask and helpWithWork
+        template<typename Policy> friend class BasicScheduler;
     private:
         Pimpl *impl;
     };
@@ -2,7 +2,9 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <cstdint>
 #include "FreeList.hpp"
+#include "Arena.hpp"
 
 namespace orbit
 {
@@ -10,6 +12,14 @@ namespace orbit
     {
         static const unsigned int MAX_WORKER_THREAD_COUNT = 16;
         static const unsigned int MAX_TASK_COUNT = 4096;
+        static const unsigned int CACHE_LINE_SIZE = 64;
+        static const size_t SCRATCH_ARENA_SIZE = 256 * 1024;
+        static const size_t FRAME_ARENA_SIZE = 4 * 1024 * 1024;
+        static const size_t TILE_SIZE = 16 * 1024;
+        static const unsigned int MAX_TILE_STREAMS = 3;
+        static const unsigned int MAX_INDEXED_STREAMS = 3;
+        static const int64_t WORKER_GROWTH_DELAY_US = 500;
+        static const unsigned int MAX_TIMER_COUNT = 1024 * 1024;
     }
     struct TaskId
     {
@@ -36,6 +46,42 @@ namespace orbit
         size_t elementStride;
     };
 
+    struct PitchedStream
+    {
+        inline PitchedStream(void* _data, size_t _stride, size_t _rowPitch, size_t _slicePitch = 0)
+            : data(_data), elementStride(_stride), rowPitch(_rowPitch), slicePitch(_slicePitch) {}
+
+        void* data;
+        size_t elementStride;
+        size_t rowPitch;
+        size_t slicePitch;
+    };
+
+    /// Cancellation state of a task. Tokens are chained through the parents of a task, so cancelling
+    /// a root also cancels every task beneath it.
+    struct CancellationToken
+    {
+        CancellationToken() : parent(nullptr)
+        {
+            cancelled = false;
+        }
+
+        bool isCancelled() const
+        {
+            for (const CancellationToken* token = this; token != nullptr; token = token->parent)
+            {
+                if (token->cancelled.load(std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::atomic<bool> cancelled;
+        const CancellationToken* parent;
+    };
+
     struct TaskData
     {
         struct StreamingData
@@ -43,33 +89,133 @@ namespace orbit
             size_t elementCount;
             void* inputStreams[3];
             void* outputStreams[3];
+
+            /// Alignment in bytes which all streams of this chunk start at.
+            size_t alignment;
+        };
+
+        struct IoData
+        {
+            int64_t* result;
+        };
+
+        struct TileData
+        {
+            /// Bounds of the tile in x, y and z, \c end is exclusive.
+            size_t begin[3];
+            size_t end[3];
+
+            /// Address of the first element of the tile in every stream, together with the pitches to walk it.
+            void* streams[3];
+            size_t rowPitch[3];
+            size_t slicePitch[3];
+        };
+
+        struct IndexedData
+        {
+            /// Slice of the index list this chunk works on.
+            size_t indexCount;
+            uint32_t* indices;
+
+            /// Base address and stride of every stream, elements are addressed through the indices.
+            void* inputStreams[3];
+            size_t inputStrides[3];
+            void* outputStreams[3];
+            size_t outputStrides[3];
+
+            /// Address of the element the \a _i-th index of the slice refers to.
+            void* gather(size_t _stream, size_t _i) const
+            {
+                return static_cast<char*>(inputStreams[_stream]) + indices[_i] * inputStrides[_stream];
+            }
+
+            void* scatter(size_t _stream, size_t _i) const
+            {
+                return static_cast<char*>(outputStreams[_stream]) + indices[_i] * outputStrides[_stream];
+            }
         };
 
         union TaskSpecificData
         {
             StreamingData streamingData;
+            IoData ioData;
+            TileData tileData;
+            IndexedData indexedData;
         };
 
+        /// Lets long running kernels poll whether their task tree has been cancelled.
+        bool isCancelled() const
+        {
+            return cancellation->isCancelled();
+        }
+
         void* kernelData;
         TaskSpecificData specificData;
+        const CancellationToken* cancellation;
+
+        /// Scratch memory of the worker running the task, released when the task finishes or at the next frame boundary.
+        LinearArena* scratch;
+
+        /// Memory shared by all tasks which stays valid until Scheduler::resetFrameArena.
+        FrameArena* frame;
     };
 
     typedef std::function<void(const TaskData&)> Kernel;
 
-    struct Task
+    /// The part of a pooled task which changes while its tree runs. TaskPool keeps these in an array of their own, one per
+    /// cache line, so counting down a task does not invalidate the payload of its neighbours.
+    struct TaskControl
+    {
+        std::atomic<size_t> openTasks;
+        int32_t generation;
+        TaskId::Offset parent;
+    };
+
+    struct PendingTimer;
+
+    /// A pooled task, \a KernelType is Kernel unless a BasicScheduler policy stores kernels differently.
+    template<typename KernelType>
+    struct BasicTask
     {
         static const TaskId::Offset NO_PARENT = -1;
 
-        Task()
+        /// Offset of tasks which were run inline by the spawning thread and never entered the pool.
+        static const TaskId::Offset INLINED = -2;
+
+        /// Delayed and periodic tasks are identified by their timer until they fire, their offsets follow the pool's.
+        static const TaskId::Offset FIRST_TIMER = configuration::MAX_TASK_COUNT;
+        static bool isTimer(TaskId::Offset _offset)
         {
-            openTasks = 1;
-            parent = Task::NO_PARENT;
+            return _offset >= FIRST_TIMER && _offset < FIRST_TIMER + configuration::MAX_TIMER_COUNT;
+        }
+
+        BasicTask()
+        {
+            taskData.cancellation = &cancellation;
+            taskData.scratch = nullptr;
+            taskData.frame = nullptr;
+            priority = 0;
+            label = nullptr;
+            durationKey = 0;
+            timer = nullptr;
         }
         Freelist* unusedFreelistAlias;
-        std::atomic<size_t> openTasks;
-        int32_t generation;
-        TaskId::Offset parent;
-        Kernel kernel;
+        KernelType kernel;
         TaskData taskData;
+        CancellationToken cancellation;
+
+        /// Expected time from the start of this task until its root finishes, used to order the queue.
+        uint64_t priority;
+        const char* label;
+        uint64_t durationKey;
+
+        /// Timer which released this task, it is told once the task has finished.
+        PendingTimer* timer;
     };
+
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::NO_PARENT;
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::INLINED;
+    template<typename KernelType> const TaskId::Offset BasicTask<KernelType>::FIRST_TIMER;
+
+    typedef BasicTask<Kernel> Task;
 }
\ No newline at end of file
@@ -1,36 +1,134 @@
 #pragma once
-#include <vector>
-#include <functional>
-#include <thread>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <atomic>
+#include <new>
 
 #include "FreeList.hpp"
 #include "TaskCore.hpp"
-#include "LockingQueue.hpp"
 
 namespace orbit
 {
-    class TaskPool
+    /// Hands out \a Capacity tasks through a freelist. The control state of every task lives apart from its payload,
+    /// see TaskControl.
+    template<typename TaskType, size_t Capacity>
+    class BasicTaskPool
     {
     public:
-        TaskPool();
-        ~TaskPool();
+        BasicTaskPool() : taskPoolMemory(new char[TASK_POOL_SIZE]), controlMemory(new char[sizeof(PaddedControl) * (Capacity + 1)]),
+            futureTaskPool(taskPoolMemory.get(), taskPoolMemory.get() + TASK_POOL_SIZE, sizeof(TaskType))
+        {
+            // heap memory is not guaranteed to be cache line aligned, so align the control array by hand
+            const uintptr_t address = reinterpret_cast<uintptr_t>(controlMemory.get());
+            const uintptr_t aligned = (address + configuration::CACHE_LINE_SIZE - 1) & ~uintptr_t(configuration::CACHE_LINE_SIZE - 1);
+            control = reinterpret_cast<PaddedControl*>(aligned);
+            generation = 0;
+            availableTasks = Capacity;
+            for (size_t i = 0; i != Capacity; ++i)
+            {
+                new(&control[i]) PaddedControl();
+                control[i].control.openTasks = 0;
+                control[i].control.generation = 0;
+                control[i].control.parent = TaskType::NO_PARENT;
+            }
+        }
 
-        Task* obtainTask();
-        void returnTask(Task* _task);
+        BasicTaskPool(const BasicTaskPool&) = delete;
 
-        TaskId::Offset getTaskOffset(Task* _task);
-        Task* getTask(TaskId::Offset _taskOffset);
+        TaskType* obtainTask()
+        {
+            void* memory = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                memory = futureTaskPool.Obtain();
+            }
+            --availableTasks;
 
-        bool isTaskFinished(const TaskId& _taskId);
+            TaskType* task = new(memory) TaskType();
+
+            TaskControl& taskControl = getControl(task);
+            taskControl.openTasks = 1;
+            taskControl.parent = TaskType::NO_PARENT;
+
+            // the generation is a unique ID which allows us to distinguish between proper tasks and deleted ones
+            taskControl.generation = ++generation;
+            return task;
+        }
+
+        void returnTask(TaskType* _task)
+        {
+            getControl(_task).generation = ++generation;
+
+            // releases whatever the kernel captured, the freelist reuses the memory right away
+            _task->~TaskType();
+            {
+                std::lock_guard<std::mutex> lock(guard);
+                futureTaskPool.Return(_task);
+            }
+            ++availableTasks;
+        }
+
+        TaskId::Offset getTaskOffset(TaskType* _task)
+        {
+            return _task - reinterpret_cast<TaskType*>(taskPoolMemory.get());
+        }
+
+        TaskType* getTask(TaskId::Offset _taskOffset)
+        {
+            return reinterpret_cast<TaskType*>(taskPoolMemory.get()) + _taskOffset;
+        }
+
+        TaskId getTaskId(TaskType* _task)
+        {
+            const TaskId::Offset offset = getTaskOffset(_task);
+            return TaskId(offset, control[offset].control.generation);
+        }
+
+        TaskControl& getControl(TaskId::Offset _taskOffset) { return control[_taskOffset].control; }
+        TaskControl& getControl(TaskType* _task) { return control[getTaskOffset(_task)].control; }
+        const TaskControl& getControl(TaskId::Offset _taskOffset) const { return control[_taskOffset].control; }
+
+        bool isTaskFinished(const TaskId& _taskId) const
+        {
+            if (_taskId.offset == TaskType::INLINED)
+            {
+                // inlined tasks ran to completion before their id was handed out
+                return true;
+            }
+
+            // only the control state is read, waiting threads never touch the payload workers are using
+            const TaskControl& taskControl = getControl(_taskId.offset);
+            if (taskControl.generation != static_cast<int32_t>(_taskId.generation))
+            {
+                // task is from an older generation and has been recycled again, so it's been finished already
+                return true;
+            }
+            return taskControl.openTasks == 0;
+        }
+
+        /// Number of tasks which can still be obtained, may be outdated as soon as it is returned.
+        size_t getAvailableTaskCount() const { return availableTasks.load(std::memory_order_relaxed); }
 
     private:
-        const unsigned int TASK_POOL_SIZE = sizeof(Task) * configuration::MAX_TASK_COUNT;
-        char taskPoolMemory[sizeof(Task) * configuration::MAX_TASK_COUNT];
+        static const size_t TASK_POOL_SIZE = sizeof(TaskType) * Capacity;
+
+        // control state lives apart from the payload, padded to whole cache lines
+        struct alignas(configuration::CACHE_LINE_SIZE) PaddedControl
+        {
+            TaskControl control;
+        };
+        static_assert(sizeof(PaddedControl) == configuration::CACHE_LINE_SIZE, "the control state of a task has to fit a cache line");
+
+        std::unique_ptr<char[]> taskPoolMemory;
+        std::unique_ptr<char[]> controlMemory;
+        PaddedControl* control;
         std::mutex guard;
 
         Freelist futureTaskPool;
-        int32_t generation;
+        std::atomic<int32_t> generation;
+        std::atomic<size_t> availableTasks;
     };
-}
\ No newline at end of file
+
+    typedef BasicTaskPool<Task, configuration::MAX_TASK_COUNT> TaskPool;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <queue>
+
+#include "LockingQueue.hpp"
+
+namespace orbit
+{
+    /// Queue of tasks ready to run, first in, first out through the policy's queue or ordered by BasicTask::priority.
+    template<typename TaskType, typename Policy>
+    class BasicTaskQueue
+    {
+    public:
+        BasicTaskQueue()
+        {
+            prioritised = false;
+            sequence = 0;
+            depth = 0;
+            urgentDepth = 0;
+        }
+
+        /// Orders the queue by Task::priority instead of first in, first out. Has to be set before any task is queued.
+        void setPrioritised(bool _prioritised)
+        {
+            prioritised.store(_prioritised, std::memory_order_release);
+        }
+
+        /// Tries to queue a task.
+        void queueTask(TaskType* _task)
+        {
+            ++depth;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                const PrioritisedTask entry = { _task->priority, sequence++, _task };
+                prioritisedQueue.push(entry);
+            }
+            else
+            {
+                queue.push(_task);
+            }
+        }
+
+        /// Queues a batch of tasks at once.
+        void queueTasks(TaskType* const* _tasks, size_t _count)
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                for (size_t i = 0; i != _count; ++i)
+                {
+                    queueTask(_tasks[i]);
+                }
+            }
+            else
+            {
+                depth += _count;
+                queue.push(_tasks, _count);
+            }
+        }
+
+        /// Queues tasks ahead of everything queued so far, such as tasks released by timers which are due already. A
+        /// prioritised queue orders them by Task::priority like any other task.
+        void queueUrgentTasks(TaskType* const* _tasks, size_t _count)
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                queueTasks(_tasks, _count);
+                return;
+            }
+
+            depth += _count;
+            urgentDepth += _count;
+            urgentQueue.push(_tasks, _count);
+
+            // workers wait on the regular queue, a wake up without a task sends them back to getAvailableTask
+            for (size_t i = 0; i != _count; ++i)
+            {
+                queue.notifyOne();
+            }
+        }
+
+        /// Waits the calling thread until a task becomes available in the queue, returns \c nullptr after \a _milliseconds.
+        TaskType* waitUntilTaskIsAvailable(int _milliseconds)
+        {
+            TaskType* task = nullptr;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                PrioritisedTask entry;
+                task = prioritisedQueue.tryWaitAndPop(entry, _milliseconds) ? entry.task : nullptr;
+            }
+            else if (!tryPopUrgent(task))
+            {
+                task = queue.tryWaitAndPop(task, _milliseconds) ? task : nullptr;
+            }
+
+            if (task)
+            {
+                --depth;
+            }
+            return task;
+        }
+
+        /// Wakes up a waiting worker so it can reconsider how long to wait for.
+        void wakeWorker()
+        {
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                prioritisedQueue.notifyOne();
+            }
+            else
+            {
+                queue.notifyOne();
+            }
+        }
+
+        /// Approximate number of queued tasks.
+        size_t size() const { return depth.load(std::memory_order_relaxed); }
+
+        /// Tries to get a task from the queue, returns \c nullptr if no task is currently available.
+        TaskType* getAvailableTask()
+        {
+            TaskType* task = nullptr;
+            if (prioritised.load(std::memory_order_acquire))
+            {
+                PrioritisedTask entry;
+                task = prioritisedQueue.tryPop(entry) ? entry.task : nullptr;
+            }
+            else if (!tryPopUrgent(task))
+            {
+                task = queue.tryPop(task) ? task : nullptr;
+            }
+
+            if (task)
+            {
+                --depth;
+            }
+            return task;
+        }
+
+    private:
+        bool tryPopUrgent(TaskType*& _task)
+        {
+            // the lane is empty nearly all the time, so it is only locked when something has been queued there
+            if (urgentDepth.load(std::memory_order_relaxed) == 0 || !urgentQueue.tryPop(_task))
+            {
+                return false;
+            }
+            --urgentDepth;
+            return true;
+        }
+
+        struct PrioritisedTask
+        {
+            uint64_t priority;
+            uint64_t sequence;
+            TaskType* task;
+
+            bool operator<(const PrioritisedTask& _other) const
+            {
+                // higher priorities first, tasks of equal priority in the order they were queued
+                return priority != _other.priority ? priority < _other.priority : sequence > _other.sequence;
+            }
+        };
+
+        std::atomic<bool> prioritised;
+        std::atomic<uint64_t> sequence;
+        std::atomic<size_t> depth;
+        std::atomic<size_t> urgentDepth;
+        typename Policy::template Queue<TaskType*> queue;
+        typename Policy::template Queue<TaskType*> urgentQueue;
+        LockingQueue<PrioritisedTask, std::priority_queue<PrioritisedTask>> prioritisedQueue;
+    };
+}
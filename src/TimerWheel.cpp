@@ -0,0 +1,148 @@
+#include "TimerWheel.hpp"
+
+namespace orbit
+{
+    TimerWheel::TimerWheel() : currentTick(0), timerCount(0) {}
+
+    void TimerWheel::schedule(const Timer& _timer)
+    {
+        insert(_timer, _timer.due > currentTick ? _timer.due : currentTick + 1);
+        ++timerCount;
+    }
+
+    void TimerWheel::insert(const Timer& _timer, uint64_t _due)
+    {
+        const uint64_t delta = _due - currentTick;
+
+        for (unsigned int level = 0; level != LEVEL_COUNT - 1; ++level)
+        {
+            if (delta < (uint64_t(1) << (SLOT_BITS * (level + 1))))
+            {
+                slots[level][(_due >> (SLOT_BITS * level)) & SLOT_MASK].push_back(_timer);
+                return;
+            }
+        }
+
+        // timers beyond the range of the wheel wait in the outermost level, they are put back once they cascade
+        const uint64_t range = (uint64_t(1) << (SLOT_BITS * LEVEL_COUNT)) - 1;
+        const uint64_t due = delta < range ? _due : currentTick + range;
+        slots[LEVEL_COUNT - 1][(due >> (SLOT_BITS * (LEVEL_COUNT - 1))) & SLOT_MASK].push_back(_timer);
+    }
+
+    void TimerWheel::cascade(unsigned int _level)
+    {
+        std::vector<Timer>& slot = slots[_level][(currentTick >> (SLOT_BITS * _level)) & SLOT_MASK];
+        cascading.swap(slot);
+
+        for (const Timer& timer : cascading)
+        {
+            insert(timer, timer.due > currentTick ? timer.due : currentTick);
+        }
+        cascading.clear();
+    }
+
+    void TimerWheel::advance(uint64_t _now, std::vector<Timer>& _expired)
+    {
+        while (currentTick < _now)
+        {
+            if (timerCount == 0)
+            {
+                // nothing to expire, jump straight to the current time
+                currentTick = _now;
+                return;
+            }
+
+            ++currentTick;
+
+            // cascade every level whose lower level wrapped around, outermost first so timers can fall through
+            unsigned int levels = 1;
+            while (levels != LEVEL_COUNT && (currentTick & ((uint64_t(1) << (SLOT_BITS * levels)) - 1)) == 0)
+            {
+                ++levels;
+            }
+            for (unsigned int level = levels - 1; level != 0; --level)
+            {
+                cascade(level);
+            }
+
+            std::vector<Timer>& slot = slots[0][currentTick & SLOT_MASK];
+            _expired.insert(_expired.end(), slot.begin(), slot.end());
+            timerCount -= slot.size();
+            slot.clear();
+        }
+    }
+
+    uint64_t TimerWheel::ticksUntilNextEvent() const
+    {
+        if (timerCount == 0)
+        {
+            return UINT64_MAX;
+        }
+
+        // look for the next occupied slot of the first level, otherwise wake up for the next cascade
+        const uint64_t untilCascade = SLOT_COUNT - (currentTick & SLOT_MASK);
+        for (uint64_t ticks = 1; ticks < untilCascade; ++ticks)
+        {
+            if (!slots[0][(currentTick + ticks) & SLOT_MASK].empty())
+            {
+                return ticks;
+            }
+        }
+        return untilCascade;
+    }
+
+    TimerTable::TimerTable() : timerCount(0)
+    {
+        for (auto& block : blocks)
+        {
+            block = nullptr;
+        }
+    }
+
+    TimerTable::~TimerTable()
+    {
+        for (auto& block : blocks)
+        {
+            delete[] block.load();
+        }
+    }
+
+    PendingTimer& TimerTable::obtain()
+    {
+        uint32_t index;
+        {
+            std::lock_guard<std::mutex> lock(guard);
+            if (!freeTimers.empty())
+            {
+                index = freeTimers.back();
+                freeTimers.pop_back();
+            }
+            else
+            {
+                // entries are never moved, released tasks keep pointing at the cancellation token of their timer
+                index = timerCount++;
+                if (index % BLOCK_SIZE == 0)
+                {
+                    blocks[index / BLOCK_SIZE].store(new PendingTimer[BLOCK_SIZE], std::memory_order_release);
+                }
+            }
+        }
+
+        PendingTimer& timer = get(index);
+        timer.index = index;
+        timer.openTasks = 1;
+        timer.parent = Task::NO_PARENT;
+        timer.label = nullptr;
+        timer.cancellation.cancelled = false;
+        return timer;
+    }
+
+    void TimerTable::release(PendingTimer& _timer)
+    {
+        _timer.kernel = nullptr;
+        ++_timer.generation;
+
+        std::lock_guard<std::mutex> lock(guard);
+        freeTimers.push_back(_timer.index);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+#include "TaskCore.hpp"
+
+namespace orbit
+{
+    /// Hierarchical timer wheel with four levels of 64 slots each. The first level has a resolution of one tick,
+    /// every further level covers 64 slots of the level below. Timers are cascaded down a level whenever the level
+    /// below wraps around, so scheduling and expiring a timer are both constant time.
+    class TimerWheel
+    {
+    public:
+        struct Timer
+        {
+            uint64_t due;
+            uint64_t interval;
+
+            /// Index of the timer's PendingTimer in the TimerTable.
+            uint32_t timer;
+        };
+
+        TimerWheel();
+
+        /// Schedules a timer, timers which are already due fire on the next tick.
+        void schedule(const Timer& _timer);
+
+        /// Advances the wheel up to \a _now and appends all timers which became due to \a _expired.
+        void advance(uint64_t _now, std::vector<Timer>& _expired);
+
+        /// Returns the number of ticks the wheel can be left alone, \c UINT64_MAX if no timers are pending.
+        uint64_t ticksUntilNextEvent() const;
+
+        size_t size() const { return timerCount; }
+
+    private:
+        static const unsigned int LEVEL_COUNT = 4;
+        static const unsigned int SLOT_BITS = 6;
+        static const unsigned int SLOT_COUNT = 1 << SLOT_BITS;
+        static const uint64_t SLOT_MASK = SLOT_COUNT - 1;
+
+        void insert(const Timer& _timer, uint64_t _due);
+        void cascade(unsigned int _level);
+
+        std::vector<Timer> slots[LEVEL_COUNT][SLOT_COUNT];
+        std::vector<Timer> cascading;
+        uint64_t currentTick;
+        size_t timerCount;
+    };
+
+    /// Kernel and state of a delayed or periodic task while it waits in the wheel. A task is only taken from the pool once
+    /// the timer fires, so pending timers are not limited by configuration::MAX_TASK_COUNT.
+    struct PendingTimer
+    {
+        PendingTimer() : kernelData(nullptr), label(nullptr), parent(Task::NO_PARENT), index(0)
+        {
+            openTasks = 0;
+            generation = 0;
+        }
+
+        Kernel kernel;
+        void* kernelData;
+        const char* label;
+        CancellationToken cancellation;
+
+        /// One for the timer while it is scheduled, plus one for every released task which has not finished yet.
+        std::atomic<size_t> openTasks;
+        std::atomic<int32_t> generation;
+        TaskId::Offset parent;
+        uint32_t index;
+    };
+
+    /// Stable storage for pending timers, allocated in blocks as needed and recycled through a free list.
+    class TimerTable
+    {
+    public:
+        TimerTable();
+        TimerTable(const TimerTable &) = delete;
+        ~TimerTable();
+
+        PendingTimer& obtain();
+        void release(PendingTimer& _timer);
+
+        PendingTimer& get(uint32_t _index)
+        {
+            return blocks[_index / BLOCK_SIZE].load(std::memory_order_acquire)[_index % BLOCK_SIZE];
+        }
+
+    private:
+        static const uint32_t BLOCK_SIZE = 1024;
+        static const uint32_t BLOCK_COUNT = configuration::MAX_TIMER_COUNT / BLOCK_SIZE;
+
+        std::atomic<PendingTimer*> blocks[BLOCK_COUNT];
+        std::mutex guard;
+        std::vector<uint32_t> freeTimers;
+        uint32_t timerCount;
+    };
+}
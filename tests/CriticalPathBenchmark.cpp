@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Task.hpp"
+
+using namespace orbit;
+
+namespace
+{
+    // kernels sleep instead of spinning so the makespan only depends on the order of the tasks, not on the cores of the machine
+    const uint8_t WORKER_COUNT = 2;
+    const int ROUND_COUNT = 5;
+
+    struct Job
+    {
+        const char* label;
+        int mergeMilliseconds;
+        int stageCount;
+        int stageMilliseconds;
+    };
+
+    // the long job is queued last, so FIFO only starts its merge once every short job is through
+    const Job jobs[] =
+    {
+        { "short merge", 1, 4, 5 },
+        { "short merge", 1, 4, 5 },
+        { "short merge", 1, 4, 5 },
+        { "long merge", 40, 4, 5 },
+    };
+
+    void sleepKernel(const TaskData& _data)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(*static_cast<const int*>(_data.kernelData)));
+    }
+
+    /// Every job is a merge task waiting for its stages, all merges are children of one root. Returns the makespan in milliseconds.
+    double runGraph(Scheduler& _scheduler)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        const TaskId root = _scheduler.addEmptyTask();
+        std::vector<TaskId> stages;
+        std::vector<TaskId> merges;
+        for (const Job& job : jobs)
+        {
+            const TaskId merge = _scheduler.addTask(const_cast<int*>(&job.mergeMilliseconds), &sleepKernel);
+            _scheduler.setLabel(merge, job.label);
+            _scheduler.addChild(root, merge);
+            merges.push_back(merge);
+
+            for (int i = 0; i != job.stageCount; ++i)
+            {
+                const TaskId stage = _scheduler.addTask(const_cast<int*>(&job.stageMilliseconds), &sleepKernel);
+                _scheduler.setLabel(stage, "stage");
+                _scheduler.addChild(merge, stage);
+                stages.push_back(stage);
+            }
+        }
+
+        for (const TaskId& stage : stages)
+        {
+            _scheduler.runTask(stage);
+        }
+        for (const TaskId& merge : merges)
+        {
+            _scheduler.runTask(merge);
+        }
+        _scheduler.runTask(root);
+        _scheduler.waitWithoutHelping(root);
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Median makespan of a policy, after a first round which teaches the scheduler the kernel durations.
+    double measure(Scheduler::SchedulingPolicy _policy)
+    {
+        Scheduler scheduler;
+        scheduler.setSchedulingPolicy(_policy);
+        scheduler.initialise(WORKER_COUNT);
+
+        runGraph(scheduler);
+        std::vector<double> makespans;
+        for (int round = 0; round != ROUND_COUNT; ++round)
+        {
+            makespans.push_back(runGraph(scheduler));
+        }
+        std::sort(makespans.begin(), makespans.end());
+        return makespans[ROUND_COUNT / 2];
+    }
+
+    void printBar(const char* _name, double _milliseconds, double _longest)
+    {
+        const int BAR_WIDTH = 50;
+        const int width = static_cast<int>(_milliseconds / _longest * BAR_WIDTH + 0.5);
+        printf("%-14s |%s%*s| %6.1f ms\n", _name, std::string(width, '#').c_str(), BAR_WIDTH - width, "", _milliseconds);
+    }
+}
+
+int main()
+{
+    int stageCount = 0;
+    int work = 0;
+    for (const Job& job : jobs)
+    {
+        stageCount += job.stageCount;
+        work += job.mergeMilliseconds + job.stageCount * job.stageMilliseconds;
+    }
+    printf("%zu jobs, %d stages, %d ms of work on %d workers, median of %d rounds\n\n", sizeof(jobs) / sizeof(jobs[0]), stageCount,
+        work, WORKER_COUNT, ROUND_COUNT);
+
+    const double fifo = measure(Scheduler::FIFO);
+    const double criticalPath = measure(Scheduler::CRITICAL_PATH);
+    const double longest = std::max(fifo, criticalPath);
+    printBar("FIFO", fifo, longest);
+    printBar("CRITICAL_PATH", criticalPath, longest);
+    printf("\ncritical path makespan: %.0f%% of FIFO\n", criticalPath / fifo * 100.0);
+
+    return 0;
+}
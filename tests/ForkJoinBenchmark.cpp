@@ -0,0 +1,148 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Task.hpp"
+#include "TaskPool.hpp"
+
+using namespace orbit;
+
+namespace
+{
+    const uint8_t threadCounts[] = { 1, 2, 4 };
+
+    const size_t ELEMENT_COUNT = 1 << 16;
+    const size_t ELEMENTS_PER_TASK = 1024;
+    const int JOIN_COUNT = 2000;
+
+    const size_t SLOT_COUNT = 256;
+    const int PASS_COUNT = 20000;
+
+    typedef std::chrono::steady_clock Clock;
+
+    double millisecondsSince(Clock::time_point _start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+    }
+
+    std::atomic<size_t> chunkCount(0);
+
+    void addOne(const TaskData& _data)
+    {
+        const TaskData::StreamingData& streamingData = _data.specificData.streamingData;
+        const float* input = static_cast<const float*>(streamingData.inputStreams[0]);
+        float* output = static_cast<float*>(streamingData.outputStreams[0]);
+        for (size_t i = 0; i != streamingData.elementCount; ++i)
+        {
+            output[i] = input[i] + 1.0f;
+        }
+        ++chunkCount;
+    }
+
+    /// Forks a streaming task into its chunks and joins on it, \a JOIN_COUNT times. Returns the joins per second.
+    double forkJoin(uint8_t _workerCount)
+    {
+        std::vector<float> input(ELEMENT_COUNT, 1.0f);
+        std::vector<float> output(ELEMENT_COUNT);
+
+        Scheduler scheduler;
+        scheduler.initialise(_workerCount);
+
+        chunkCount = 0;
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i != JOIN_COUNT; ++i)
+        {
+            const TaskId root = scheduler.addStreamingTask(&addOne, nullptr,
+                InputStream(&input[0], sizeof(float)), OutputStream(&output[0], sizeof(float)), ELEMENT_COUNT, ELEMENTS_PER_TASK);
+            scheduler.runTask(root);
+            scheduler.wait(root);
+        }
+        const double milliseconds = millisecondsSince(start);
+
+        if (chunkCount != JOIN_COUNT * (ELEMENT_COUNT / ELEMENTS_PER_TASK))
+        {
+            printf("lost chunks: %zu of %zu\n", chunkCount.load(), JOIN_COUNT * (ELEMENT_COUNT / ELEMENTS_PER_TASK));
+        }
+        return JOIN_COUNT / milliseconds * 1000.0;
+    }
+
+    // the layout before the split: the control state shares cache lines with the payload of the task and its neighbours
+    struct InlineTask
+    {
+        TaskControl control;
+        Task payload;
+    };
+
+    /// Siblings finishing at the same time: every thread counts down the slots it owns and reads the payload of the
+    /// neighbouring slot, which another thread counts down. Returns nanoseconds per count down.
+    template<typename ControlOf, typename PayloadOf>
+    double countDown(size_t _threadCount, ControlOf _controlOf, PayloadOf _payloadOf)
+    {
+        std::atomic<size_t> checksum(0);
+        std::vector<std::thread> threads;
+        const Clock::time_point start = Clock::now();
+        for (size_t t = 0; t != _threadCount; ++t)
+        {
+            threads.push_back(std::thread([=, &checksum]()
+            {
+                size_t sum = 0;
+                for (int pass = 0; pass != PASS_COUNT; ++pass)
+                {
+                    for (size_t slot = t; slot < SLOT_COUNT; slot += _threadCount)
+                    {
+                        TaskControl& control = _controlOf(slot);
+                        ++control.openTasks;
+                        sum += _payloadOf((slot + 1) % SLOT_COUNT).taskData.specificData.streamingData.elementCount;
+                        --control.openTasks;
+                    }
+                }
+                checksum += sum;
+            }));
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        return millisecondsSince(start) * 1000000.0 / (static_cast<double>(PASS_COUNT) * SLOT_COUNT);
+    }
+}
+
+int main()
+{
+    printf("hardware threads: %u\n\n", std::thread::hardware_concurrency());
+
+    printf("fork/join, %zu chunks per join\n", ELEMENT_COUNT / ELEMENTS_PER_TASK);
+    for (uint8_t workerCount : threadCounts)
+    {
+        printf("  %u workers: %8.0f joins/s\n", workerCount, forkJoin(workerCount));
+    }
+
+    std::unique_ptr<InlineTask[]> inlineTasks(new InlineTask[SLOT_COUNT]);
+    std::unique_ptr<BasicTaskPool<Task, SLOT_COUNT> > pool(new BasicTaskPool<Task, SLOT_COUNT>());
+    for (size_t slot = 0; slot != SLOT_COUNT; ++slot)
+    {
+        inlineTasks[slot].control.openTasks = 1;
+        inlineTasks[slot].payload.taskData.specificData.streamingData.elementCount = slot;
+        pool->obtainTask()->taskData.specificData.streamingData.elementCount = slot;
+    }
+
+    printf("\ncounting down neighbouring tasks, ns per count down\n");
+    printf("  threads    inline     split\n");
+    for (uint8_t threadCount : threadCounts)
+    {
+        InlineTask* tasks = inlineTasks.get();
+        BasicTaskPool<Task, SLOT_COUNT>* split = pool.get();
+        const double inlineLayout = countDown(threadCount,
+            [tasks](size_t _slot) -> TaskControl& { return tasks[_slot].control; },
+            [tasks](size_t _slot) -> const Task& { return tasks[_slot].payload; });
+        const double splitLayout = countDown(threadCount,
+            [split](size_t _slot) -> TaskControl& { return split->getControl(static_cast<TaskId::Offset>(_slot)); },
+            [split](size_t _slot) -> const Task& { return *split->getTask(static_cast<TaskId::Offset>(_slot)); });
+        printf("  %7u  %8.2f  %8.2f\n", threadCount, inlineLayout, splitLayout);
+    }
+
+    return 0;
+}
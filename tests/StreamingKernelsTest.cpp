@@ -0,0 +1,151 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "StreamingKernels.hpp"
+
+using namespace orbit;
+
+namespace
+{
+    typedef void (*KernelFunction)(const TaskData&);
+
+    enum ElementType
+    {
+        F32,
+        I32,
+    };
+
+    struct KernelCase
+    {
+        const char* name;
+        KernelFunction kernel;
+        ElementType input;
+        size_t inputCount;
+    };
+
+    const char* instructionSetNames[] = { "SCALAR", "SSE2", "AVX2", "AVX512" };
+
+    const KernelCase kernelCases[] =
+    {
+        { "addF32", &kernels::addF32, F32, 2 },
+        { "subtractF32", &kernels::subtractF32, F32, 2 },
+        { "multiplyF32", &kernels::multiplyF32, F32, 2 },
+        { "minF32", &kernels::minF32, F32, 2 },
+        { "maxF32", &kernels::maxF32, F32, 2 },
+        { "addI32", &kernels::addI32, I32, 2 },
+        { "subtractI32", &kernels::subtractI32, I32, 2 },
+        { "multiplyI32", &kernels::multiplyI32, I32, 2 },
+        { "minI32", &kernels::minI32, I32, 2 },
+        { "maxI32", &kernels::maxI32, I32, 2 },
+        { "saxpy", &kernels::saxpy, F32, 2 },
+        { "clampF32", &kernels::clampF32, F32, 1 },
+        { "clampI32", &kernels::clampI32, I32, 1 },
+        { "convertF32ToI32", &kernels::convertF32ToI32, F32, 1 },
+        { "convertI32ToF32", &kernels::convertI32ToF32, I32, 1 },
+    };
+
+    // lengths around every lane count so each implementation runs empty, tail only and vector plus tail
+    const size_t elementCounts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1037 };
+
+    uint32_t nextRandom(uint32_t& _state)
+    {
+        _state = _state * 1664525u + 1013904223u;
+        return _state >> 8;
+    }
+
+    // floats stay within int32_t range so the conversion is defined, the integers cover the full range to exercise wrap around
+    void fill(std::vector<uint32_t>& _stream, ElementType _type, size_t _count, uint32_t _seed)
+    {
+        uint32_t state = _seed;
+        for (size_t i = 0; i != _count; ++i)
+        {
+            const uint32_t high = nextRandom(state);
+            const uint32_t low = nextRandom(state);
+            if (_type == F32)
+            {
+                const float value = (static_cast<float>(high) / 16777216.0f - 0.5f) * 2000.0f;
+                memcpy(&_stream[i], &value, sizeof(value));
+            }
+            else
+            {
+                _stream[i] = high << 8 | (low & 0xff);
+            }
+        }
+    }
+
+    void run(const KernelCase& _case, kernels::InstructionSet _instructionSet, size_t _elementCount, std::vector<uint32_t>& _output)
+    {
+        static kernels::SaxpyParameters saxpyParameters = { 1.37f };
+        static kernels::ClampF32Parameters clampF32Parameters = { -250.0f, 400.0f };
+        static kernels::ClampI32Parameters clampI32Parameters = { -1000000, 2000000 };
+
+        std::vector<uint32_t> inputs[2];
+        for (size_t stream = 0; stream != _case.inputCount; ++stream)
+        {
+            inputs[stream].resize(_elementCount + 1);
+            fill(inputs[stream], _case.input, _elementCount, static_cast<uint32_t>(17 + stream * 31 + _elementCount));
+        }
+        // one extra element behind the output catches kernels writing past the end
+        _output.assign(_elementCount + 1, 0xdeadbeefu);
+
+        TaskData data = {};
+        data.specificData.streamingData.elementCount = _elementCount;
+        for (size_t stream = 0; stream != _case.inputCount; ++stream)
+        {
+            data.specificData.streamingData.inputStreams[stream] = &inputs[stream][0];
+        }
+        data.specificData.streamingData.outputStreams[0] = &_output[0];
+        if (_case.kernel == &kernels::saxpy)
+        {
+            data.kernelData = &saxpyParameters;
+        }
+        else if (_case.kernel == &kernels::clampF32)
+        {
+            data.kernelData = &clampF32Parameters;
+        }
+        else if (_case.kernel == &kernels::clampI32)
+        {
+            data.kernelData = &clampI32Parameters;
+        }
+
+        kernels::selectInstructionSet(_instructionSet);
+        _case.kernel(data);
+    }
+}
+
+int main()
+{
+    const kernels::InstructionSet supported = kernels::detectInstructionSet();
+    printf("supported instruction set: %s\n", instructionSetNames[supported]);
+
+    size_t failures = 0;
+    std::vector<uint32_t> expected;
+    std::vector<uint32_t> actual;
+    for (int instructionSet = kernels::SSE2; instructionSet <= supported; ++instructionSet)
+    {
+        const size_t previousFailures = failures;
+        for (size_t k = 0; k != sizeof(kernelCases) / sizeof(kernelCases[0]); ++k)
+        {
+            size_t mismatches = 0;
+            for (size_t c = 0; c != sizeof(elementCounts) / sizeof(elementCounts[0]); ++c)
+            {
+                run(kernelCases[k], kernels::SCALAR, elementCounts[c], expected);
+                run(kernelCases[k], static_cast<kernels::InstructionSet>(instructionSet), elementCounts[c], actual);
+                for (size_t i = 0; i != expected.size(); ++i)
+                {
+                    // compare bit patterns so differently rounded floats are caught as well
+                    if (expected[i] != actual[i] && mismatches++ == 0)
+                    {
+                        printf("%s %s: element %zu of %zu differs, expected 0x%08x, got 0x%08x\n", instructionSetNames[instructionSet],
+                            kernelCases[k].name, i, elementCounts[c], expected[i], actual[i]);
+                    }
+                }
+            }
+            failures += mismatches != 0;
+        }
+        printf("%s: %s\n", instructionSetNames[instructionSet], failures == previousFailures ? "ok" : "FAILED");
+    }
+
+    return failures == 0 ? 0 : 1;
+}